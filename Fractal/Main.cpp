@@ -5,8 +5,11 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <memory>
 #include <chrono>
 #include "math.h"
+#include "formula.h"
+#include "render_service.h"
 #include <fstream>
 
 #include <complex>
@@ -17,45 +20,23 @@
  
 #include <algorithm> // For std::min and std::max
 
-// Custom clamp function for C++14 or earlier
-template <typename T>
-constexpr const T& clamp(const T& v, const T& lo, const T& hi) {
-	return std::min(std::max(v, lo), hi);
-}
-
-
 #define M_PI 3.14159265358979
 
 #define WINDOW_WIDTH 900
 #define WINDOW_HEIGHT 780
-#define THREAD_COUNT 4
-
-
+#define FORMULA_FILE "formulas.txt" // user formulas, one "name: z = ..." per line
 
 
-enum FractalType {
-	MANDELBROT, KOCH, SIERPINSKI_CARPET, CANTOR, DRAGON, PEANO, HILBERT,
-	SIERPINSKI_TRIANGLE, BOX, LEVY, GOSPER, CESARO, CANTOR_TERNARY,
-	KOCH_SNOWFLAKE, SIERPINSKI_ARROWHEAD, QUADRIC_KOCH, MINKOWSKI,
-	MOORE, SIERPINSKI_HEXAGON, CANTOR_MAZE, KOCH_ANTI_SNOWFLAKE, PEANO_MEANDER,
-	TERDRAGON, VICSEK, KOCH_ISLAND, HEXAFLAKE, HEIGHWAY_DRAGON, SNOWFLAKE_SWEEP,
-	CANTOR_SQUARE, HILBERT_VARIANT, SIERPINSKI_PENTAGON, DEKKING, GOSPER_ISLAND,
-	SIERPINSKI_SQUARE, KOCH_QUADRATIC, CANTOR_CLOUD
-};
 
-struct Viewport {
-	double x_min = -2.0, x_max = 1.0;
-	double y_min = -1.5, y_max = 1.5;
-	double zoom = 1.0;
-};
-
-
-std::vector<std::vector<float>> pixel_data(WINDOW_HEIGHT, std::vector<float>(WINDOW_WIDTH, 0.0f));
-// std::vector<float> pixel_data(WINDOW_WIDTH* WINDOW_HEIGHT, 0.0f);
- 
 
 FractalType current_fractal = MANDELBROT;
-std::mutex mtx;
+bool cpu_mandelbrot = false; // Mandelbrot through the CPU kernels instead of the shader
+bool distance_estimation = false; // CPU escape-time fractals shown by distance estimate (the Mandelbrot set goes to the CPU)
+Precision render_precision = PRECISION_AUTO; // escape-time arithmetic on the CPU path
+Precision logged_precision = PRECISION_AUTO; // last tier reported on the console
+std::unique_ptr<RenderService> render_service;
+std::shared_ptr<const FormulaProgram> current_formula; // shown when current_fractal is USER_FORMULA
+std::size_t formula_index = 0; // its position among the formulas of FORMULA_FILE that compiled
 
 GLuint texture = 0;
 
@@ -66,87 +47,14 @@ void check_gl_error(const char* stage) {
 	}
 }
 
- 
-void compute_fractal(Viewport& view, FractalType type) {
-	std::vector<std::thread> threads;
-	int rows_per_thread = WINDOW_HEIGHT / THREAD_COUNT;
-
-
-	 
-
-	for (int t = 0; t < THREAD_COUNT; ++t) {
-		threads.emplace_back([&, t]() {
-			int start_row = t * rows_per_thread;
-			int end_row = (t == THREAD_COUNT - 1) ? WINDOW_HEIGHT : start_row + rows_per_thread;
-
-			for (int y = start_row; y < end_row; ++y) {
-				for (int x = 0; x < WINDOW_WIDTH; ++x) {
-					double real = view.x_min + (view.x_max - view.x_min) * x / WINDOW_WIDTH;
-					double imag = view.y_min + (view.y_max - view.y_min) * y / WINDOW_HEIGHT;
-					float value = 0.0f;
-					int iterations = 6;
-
-					switch (type) {
-
-						 
-		 
-
-					case SIERPINSKI_CARPET: value = sierpinski_carpet(real, imag, iterations); break;
-					case CANTOR: value = cantor_dust(real, imag, iterations); break;
-					case PEANO: value = peano_curve(real, imag, iterations); break;
-					case HILBERT: value = hilbert_curve(real, imag, iterations); break;
-					case SIERPINSKI_TRIANGLE: value = sierpinski_triangle(real, imag, iterations); break;
-					case BOX: value = box_fractal(real, imag, iterations); break;
-					case CANTOR_TERNARY: value = cantor_ternary_grid(real, imag, iterations); break;
-					case SIERPINSKI_HEXAGON: value = sierpinski_hexagon(real, imag, iterations); break;
-					case CANTOR_MAZE: value = cantor_maze(real, imag, iterations); break;
-					case PEANO_MEANDER: value = peano_meander_curve(real, imag, iterations); break;
-					case VICSEK: value = vicsek_fractal(real, imag, iterations); break;
-					case HEXAFLAKE: value = hexaflake(real, imag, iterations); break;
-					case CANTOR_SQUARE: value = cantor_square(real, imag, iterations); break;
-					case HILBERT_VARIANT: value = hilbert_variant(real, imag, iterations); break;
-					case SIERPINSKI_PENTAGON: value = sierpinski_pentagon(real, imag, iterations); break;
-					case CANTOR_CLOUD: value = cantor_cloud(real, imag, iterations); break;
-					case MOORE: value = moore_curve(real, imag, iterations); break;
-					case SIERPINSKI_SQUARE: value = sierpinski_square(real, imag, iterations); break;
-
- 
- 		 
-
-					default: value = 0.1f; break;
-					}
-
-
-					value = clamp(value, 0.0f, 1.0f);
-
-
-					// Debug: Log if value is out of range
-					if (value < 0.0f || value > 1.0f) {
-						std::lock_guard<std::mutex> lock(mtx);
-						std::cerr << "Invalid value for fractal " << type << " at (" << real << ", " << imag << "): " << value << std::endl;
-					}
-
-					std::lock_guard<std::mutex> lock(mtx);
-					if (y >= 0 && y < WINDOW_HEIGHT && x >= 0 && x < WINDOW_WIDTH) {
-						pixel_data[y][x] = value;
-					}
-
-				}
-			}
-			});
-	} 
-
-
-	for (auto& thread : threads) {
-		thread.join();
-	}
-
-	glGenTextures(1, &texture);
+// Uploads the finished front buffer into the existing texture.
+void upload_frame(const FrameBuffer& source) {
 	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, WINDOW_WIDTH, WINDOW_HEIGHT, 0, GL_RED, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	check_gl_error("texture setup");
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, source.stride());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, source.width(), source.height(), GL_RED, GL_FLOAT, source.data());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	check_gl_error("texture upload");
 }
 
 GLuint compile_shader(const char* source, GLenum type) {
@@ -183,7 +91,7 @@ GLuint create_shader_program(const char* vertex_source, const char* fragment_sou
 }
 
 
-void render_line_fractal(GLuint shader_program, Viewport& view, FractalType type, GLuint vao, GLuint vbo) {
+void render_line_fractal(GLuint shader_program, DoubleViewport& view, FractalType type, GLuint vao, GLuint vbo) {
 	std::vector<std::complex<double>> points;
 	int iterations = 6; // Adjustable iterations
 
@@ -241,7 +149,7 @@ void render_line_fractal(GLuint shader_program, Viewport& view, FractalType type
 }
 
 
-void render_line_fractal2(GLuint shader_program, Viewport& view, FractalType type, GLuint vao, GLuint vbo) {
+void render_line_fractal2(GLuint shader_program, DoubleViewport& view, FractalType type, GLuint vao, GLuint vbo) {
 	std::vector<std::complex<double>> points;
 	if (type == KOCH) points = generate_koch_curve(4);
 
@@ -266,7 +174,33 @@ void render_line_fractal2(GLuint shader_program, Viewport& view, FractalType typ
 	glBindVertexArray(0);
 }
 
+// Re-reads FORMULA_FILE, so edits show without a restart, and returns the
+// formula after the current one (the first if none is shown), or null if
+// the file has none that compile.
+std::shared_ptr<const FormulaProgram> next_formula() {
+	std::vector<std::shared_ptr<const FormulaProgram>> formulas;
+	std::vector<std::string> errors;
+	if (!load_formulas(FORMULA_FILE, formulas, errors)) {
+		std::cerr << "Could not open " << FORMULA_FILE << std::endl;
+		return nullptr;
+	}
+	for (const std::string& error : errors) std::cerr << error << std::endl;
+	if (formulas.empty()) return nullptr;
+	formula_index = current_fractal == USER_FORMULA ? (formula_index + 1) % formulas.size() : 0;
+	return formulas[formula_index];
+}
+
 int main(int argc, char* argv[]) {
+	render_service.reset(new RenderService(WINDOW_WIDTH, WINDOW_HEIGHT, resolve_thread_count(argc, argv)));
+	std::cout << "Render threads: " << render_service->thread_count() << std::endl;
+	select_kernel_isa(resolve_kernel_isa(argc, argv));
+	std::cout << "Kernel variant: " << kernel_isa_name(kernel_isa()) << " (CPU supports " << kernel_isa_name(detect_kernel_isa()) << ")" << std::endl;
+	double frame_budget = resolve_frame_budget(argc, argv);
+	if (frame_budget > 0.0) {
+		render_service->set_frame_budget(frame_budget);
+		std::cout << "Frame budget: " << frame_budget << " ms" << std::endl;
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
 		return 1;
@@ -337,18 +271,42 @@ int main(int argc, char* argv[]) {
     in vec2 fragCoord;
     out vec4 fragColor;
     uniform float maxIter;
+    uniform int interiorChecks;
     uniform int useTexture;
     uniform vec2 view_min;
     uniform vec2 view_max;
     uniform vec3 color;
+    uniform sampler2D textureSampler;
+
+    // Interior checks as in mandelbrot_point (math.cpp): the main cardioid
+    // and period-2 bulb, then Brent's cycle test on the orbit
+    bool in_main_bulbs(vec2 c) {
+        float x = c.x - 0.25;
+        float y2 = c.y * c.y;
+        float q = x * x + y2;
+        if (q * (q + x) <= 0.25 * y2) return true;
+        return (c.x + 1.0) * (c.x + 1.0) + y2 <= 0.0625;
+    }
 
     float mandelbrot(vec2 c) {
+        if (interiorChecks == 1 && in_main_bulbs(c)) {
+            return 1.0;
+        }
         vec2 z = vec2(0.0, 0.0);
+        vec2 saved = z;
         for (int i = 0; i < int(maxIter); i++) {
             z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
             if (dot(z, z) > 4.0) {
                 return float(i) / maxIter;
             }
+            if (interiorChecks == 1) {
+                if (z == saved) {
+                    return 1.0;
+                }
+                if ((i & (i + 1)) == 0) {
+                    saved = z;
+                }
+            }
         }
         return 1.0;
     }
@@ -358,6 +316,9 @@ int main(int argc, char* argv[]) {
             vec2 c = view_min + fragCoord * (view_max - view_min);
             float value = mandelbrot(c);
             fragColor = vec4(color * value, 1.0);
+        } else if (useTexture == 2) {
+            float value = texture(textureSampler, fragCoord).r;
+            fragColor = vec4(color * value, 1.0);
         } else {
             fragColor = vec4(1.0, 0.0, 0.0, 1.0); // Red for lines
         }
@@ -395,6 +356,8 @@ int main(int argc, char* argv[]) {
 	int mouse_x, mouse_y;
 	int iterations = 100;
 	float color[3] = { 1.0f, 1.0f, 1.0f };
+	bool texture_dirty = false; // texture no longer holds the renderer's front buffer
+	bool subdivide[USER_FORMULA + 1] = {}; // Mariani-Silver on the CPU path, per fractal, off until toggled with ;
 
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
@@ -441,6 +404,18 @@ int main(int argc, char* argv[]) {
 				case SDLK_c: current_fractal = GOSPER_ISLAND; view = { -0.5, 1.5, -0.5, 1.0, 1.0 }; break;
 				case SDLK_v: current_fractal = KOCH_QUADRATIC; view = { -0.5, 1.5, -0.5, 1.0, 1.0 }; break;
 				case SDLK_b: current_fractal = CANTOR_CLOUD; view = { 0.0, 1.0, 0.0, 1.0, 1.0 }; break;
+				case SDLK_F1: current_fractal = JULIA; view = { -1.6, 1.6, -1.6, 1.6, 1.0 }; break;
+				case SDLK_F2: current_fractal = MULTIBROT; view = { -1.5, 1.5, -1.5, 1.5, 1.0 }; break;
+				case SDLK_F3: current_fractal = BURNING_SHIP; view = { -2.5, 1.5, -2.0, 2.0, 1.0 }; break;
+				case SDLK_F4: current_fractal = TRICORN; view = { -2.0, 2.0, -2.0, 2.0, 1.0 }; break;
+				case SDLK_F5:
+					if (std::shared_ptr<const FormulaProgram> formula = next_formula()) {
+						current_fractal = USER_FORMULA;
+						current_formula = formula;
+						view = { -2.0, 2.0, -2.0, 2.0, 1.0 };
+						std::cout << "Formula " << formula->name() << ": " << formula->source() << std::endl;
+					}
+					break;
 
 
 
@@ -449,13 +424,57 @@ int main(int argc, char* argv[]) {
 
 				case SDLK_SPACE: view = { -2.0, 1.0, -1.5, 1.5, 1.0 }; iterations = 100; color[0] = 1.0f; color[1] = 1.0f; color[2] = 1.0f; break;
 
+				case SDLK_TAB:
+					render_service->set_progressive(!render_service->is_progressive());
+					std::cout << "Progressive rendering: " << (render_service->is_progressive() ? "on" : "off") << std::endl;
+					break;
+
+				case SDLK_m:
+					cpu_mandelbrot = !cpu_mandelbrot;
+					std::cout << "Mandelbrot renderer: " << (cpu_mandelbrot ? "CPU" : "GPU") << std::endl;
+					break;
+
+				case SDLK_n:
+					render_precision = static_cast<Precision>((render_precision + 1) % (PRECISION_PERTURBATION + 1));
+					std::cout << "Precision: " << precision_name(render_precision) << std::endl;
+					break;
+
+				case SDLK_PERIOD:
+					set_interior_checks(!interior_checks());
+					std::cout << "Interior checks: " << (interior_checks() ? "on" : "off") << std::endl;
+					break;
+
+				case SDLK_SEMICOLON:
+					subdivide[current_fractal] = !subdivide[current_fractal];
+					std::cout << "Rectangle subdivision: " << (subdivide[current_fractal] ? "on" : "off") << std::endl;
+					break;
+
+				case SDLK_BACKSLASH:
+					distance_estimation = !distance_estimation;
+					std::cout << "Distance estimation: " << (distance_estimation ? "on" : "off") << std::endl;
+					break;
+
+				case SDLK_QUOTE:
+					render_service->set_tile_classification(!render_service->is_tile_classification());
+					std::cout << "Tile classification: " << (render_service->is_tile_classification() ? "on" : "off") << std::endl;
+					break;
+
 
 				 
 				case SDLK_EXCLAIM: std::cout << "Commands:" << std::endl;
 					std::cout << "1-9: Change fractal" << std::endl;
+					std::cout << "F1-F4: Julia set, Multibrot (z^3), Burning Ship, Tricorn" << std::endl;
+					std::cout << "F5: Next user formula from " << FORMULA_FILE << " (re-read each time)" << std::endl;
 					std::cout << "Up/Down: Change iterations" << std::endl;
 					std::cout << "r/g/b: Change color" << std::endl;
 					std::cout << "Space: Reset" << std::endl;
+					std::cout << "Tab: Toggle progressive rendering" << std::endl;
+					std::cout << "m: Toggle CPU/GPU Mandelbrot" << std::endl;
+					std::cout << "n: Cycle CPU precision (auto/float/double/double-double/perturbation)" << std::endl;
+					std::cout << ".: Toggle Mandelbrot interior checks" << std::endl;
+					std::cout << ";: Toggle rectangle subdivision for this fractal" << std::endl;
+					std::cout << "': Toggle Mandelbrot tile classification" << std::endl;
+					std::cout << "\\: Toggle distance estimation (Mandelbrot, Julia, Multibrot)" << std::endl;
 					std::cout << "h: Help" << std::endl;
 					std::cout << "q: Quit" << std::endl;
 					break;
@@ -489,6 +508,7 @@ int main(int argc, char* argv[]) {
 						glBindTexture(GL_TEXTURE_2D, texture);
 						//glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, WINDOW_WIDTH, WINDOW_HEIGHT, 0, GL_RED, GL_FLOAT, nullptr);
 						glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, data.data());
+						texture_dirty = true;
 						std::cout << "Loaded from fractal.ppm" << std::endl;
 					}
 					else {
@@ -515,16 +535,38 @@ int main(int argc, char* argv[]) {
 					break;
 				}
 				case SDLK_HASH: {
-					auto start = std::chrono::high_resolution_clock::now();
-					compute_fractal(view, current_fractal);
-					auto end = std::chrono::high_resolution_clock::now();
-					std::cout << "Time to compute fractal: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+					RenderKey key = { current_fractal, view, fractal_iterations(current_fractal, iterations), WINDOW_WIDTH, WINDOW_HEIGHT, render_precision,
+						subdivide[current_fractal], current_fractal == USER_FORMULA ? current_formula : nullptr, distance_estimation };
+					render_service->with_renderer([&](Renderer& renderer) {
+						auto start = std::chrono::high_resolution_clock::now();
+						renderer.compute_fractal(key);
+						auto end = std::chrono::high_resolution_clock::now();
+						std::cout << "Time to compute fractal: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+						});
 					break;
 				}
 				case SDLK_ASTERISK: {
-					std::cout << "Viewport: " << view.x_min << ", " << view.y_min << " -> " << view.x_max << ", " << view.y_max << std::endl;
+					// Enough decimals to place the centre to a millionth of the view
+					int digits = std::max(6, static_cast<int>(-view.log_scale * 0.30103) + 6);
+					std::cout << "Viewport: centre " << view.center_x.to_string(digits) << ", " << view.center_y.to_string(digits) <<
+						", extent " << view.width() << " x " << view.height() << std::endl;
+					if (current_fractal == USER_FORMULA) std::cout << "Formula: " << current_formula->name() << ": " << current_formula->source() << std::endl;
 					std::cout << "Iterations: " << iterations << std::endl;
 					std::cout << "Color: " << color[0] << ", " << color[1] << ", " << color[2] << std::endl;
+					std::cout << "Render threads: " << render_service->thread_count() << std::endl;
+					std::cout << "Kernel variant: " << kernel_isa_name(kernel_isa()) << std::endl;
+					std::cout << "Mandelbrot renderer: " << (cpu_mandelbrot ? "CPU" : "GPU") << std::endl;
+					std::cout << "Precision: " << precision_name(render_precision) << " (rendering in " << precision_name(render_service->precision()) << ")" << std::endl;
+					std::cout << "Rectangle subdivision: " << (subdivide[current_fractal] ? "on" : "off") << std::endl;
+					std::cout << "Distance estimation: " << (distance_estimation ? "on" : "off") << std::endl;
+					std::cout << "Progressive: " << (render_service->is_progressive() ? "on" : "off") << std::endl;
+					std::cout << "Tile classification: " << (render_service->is_tile_classification() ? "on" : "off") << std::endl;
+					if (render_service->get_frame_budget() > 0.0) {
+						std::cout << "Frame budget: " << render_service->get_frame_budget() << " ms" << std::endl;
+					}
+					else {
+						std::cout << "Frame budget: off" << std::endl;
+					}
 					break;
 				}
 				case SDLK_PLUS: {
@@ -545,14 +587,11 @@ int main(int argc, char* argv[]) {
 				
 			}
 			if (event.type == SDL_MOUSEWHEEL) {
+				// wheel.x/y are scroll amounts, so anchor on the cursor instead
+				int cursor_x, cursor_y;
+				SDL_GetMouseState(&cursor_x, &cursor_y);
 				double zoom_factor = event.wheel.y > 0 ? 0.9 : 1.1;
-				double mx = view.x_min + (view.x_max - view.x_min) * (event.wheel.x / (double)WINDOW_WIDTH);
-				double my = view.y_min + (view.y_max - view.y_min) * (event.wheel.y / (double)WINDOW_HEIGHT);
-				view.x_min = mx + (view.x_min - mx) * zoom_factor;
-				view.x_max = mx + (view.x_max - mx) * zoom_factor;
-				view.y_min = my + (view.y_min - my) * zoom_factor;
-				view.y_max = my + (view.y_max - my) * zoom_factor;
-				view.zoom *= zoom_factor;
+				view.zoom_at(cursor_x / (double)WINDOW_WIDTH, 1.0 - cursor_y / (double)WINDOW_HEIGHT, zoom_factor);
 			}
 			if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
 				dragging = true;
@@ -563,51 +602,54 @@ int main(int argc, char* argv[]) {
 				dragging = false;
 			}
 			if (event.type == SDL_MOUSEMOTION && dragging) {
-				double dx = (view.x_max - view.x_min) * (mouse_x - event.motion.x) / WINDOW_WIDTH;
-				double dy = (view.y_max - view.y_min) * (event.motion.y - mouse_y) / WINDOW_HEIGHT;
-				view.x_min += dx;
-				view.x_max += dx;
-				view.y_min += dy;
-				view.y_max += dy;
+				view.pan((mouse_x - event.motion.x) / (double)WINDOW_WIDTH, (event.motion.y - mouse_y) / (double)WINDOW_HEIGHT);
 				mouse_x = event.motion.x;
 				mouse_y = event.motion.y;
 			}
 		}
 
-		if (current_fractal == MANDELBROT) {
+		// The shader and the line fractals work in (at most) double
+		DoubleViewport flat_view = view.bounds<double>();
+		if (current_fractal == MANDELBROT && !cpu_mandelbrot && !distance_estimation) {
 			glClear(GL_COLOR_BUFFER_BIT);
 			glUseProgram(shader_program);
 			glUniform1i(glGetUniformLocation(shader_program, "useTexture"), 1);
 			glUniform1i(glGetUniformLocation(shader_program, "fractalType"), (int)current_fractal);
 			glUniform1f(glGetUniformLocation(shader_program, "maxIter"), iterations);
-			glUniform2f(glGetUniformLocation(shader_program, "view_min"), (float)view.x_min, (float)view.y_min);
-			glUniform2f(glGetUniformLocation(shader_program, "view_max"), (float)view.x_max, (float)view.y_max);
+			glUniform1i(glGetUniformLocation(shader_program, "interiorChecks"), interior_checks() ? 1 : 0);
+			glUniform2f(glGetUniformLocation(shader_program, "view_min"), (float)flat_view.x_min, (float)flat_view.y_min);
+			glUniform2f(glGetUniformLocation(shader_program, "view_max"), (float)flat_view.x_max, (float)flat_view.y_max);
 			glUniform3fv(glGetUniformLocation(shader_program, "color"), 1, color);
 			glBindVertexArray(quad_vao);
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 			check_gl_error("mandelbrot render");
 		}
 		else {
-			bool is_pixel_fractal = current_fractal == SIERPINSKI_CARPET || current_fractal == CANTOR ||
-				current_fractal == PEANO || current_fractal == HILBERT ||
-				current_fractal == SIERPINSKI_TRIANGLE || current_fractal == BOX ||
-				current_fractal == CANTOR_TERNARY || current_fractal == SIERPINSKI_HEXAGON ||
-				current_fractal == CANTOR_MAZE || current_fractal == PEANO_MEANDER ||
-				current_fractal == VICSEK || current_fractal == HEXAFLAKE ||
-				current_fractal == CANTOR_SQUARE || current_fractal == HILBERT_VARIANT ||
-				current_fractal == SIERPINSKI_PENTAGON || current_fractal == CANTOR_CLOUD ||
-				current_fractal == MOORE || current_fractal == SIERPINSKI_SQUARE;
- 
-
-			if (is_pixel_fractal) {
-				compute_fractal(view, current_fractal);
+			if (is_pixel_fractal(current_fractal) || is_escape_time(current_fractal) || current_fractal == USER_FORMULA) {
+				// Rendering runs on the render service thread; the texture is only
+				// re-uploaded when it has presented a newer frame.
+				RenderKey key = { current_fractal, view, fractal_iterations(current_fractal, iterations), WINDOW_WIDTH, WINDOW_HEIGHT, render_precision,
+					subdivide[current_fractal], current_fractal == USER_FORMULA ? current_formula : nullptr, distance_estimation };
+				// Refine around the cursor (the zoom anchor) first; frame rows
+				// run bottom-up
+				int cursor_x, cursor_y;
+				SDL_GetMouseState(&cursor_x, &cursor_y);
+				render_service->set_focus(cursor_x + 0.5, WINDOW_HEIGHT - cursor_y - 0.5);
+				render_service->post(key);
+				if (render_service->fetch(upload_frame, texture_dirty)) {
+					texture_dirty = false;
+				}
+				if (is_escape_time(current_fractal) && render_service->precision() != logged_precision) {
+					logged_precision = render_service->precision();
+					std::cout << "Rendering in " << precision_name(logged_precision) << std::endl;
+				}
 				glClear(GL_COLOR_BUFFER_BIT);
 				glUseProgram(shader_program);
-				glUniform1i(glGetUniformLocation(shader_program, "useTexture"), 1);
+				glUniform1i(glGetUniformLocation(shader_program, "useTexture"), 2);
 				glUniform1i(glGetUniformLocation(shader_program, "fractalType"), (int)current_fractal);
 				glUniform1f(glGetUniformLocation(shader_program, "maxIter"), iterations);
-				glUniform2f(glGetUniformLocation(shader_program, "view_min"), (float)view.x_min, (float)view.y_min);
-				glUniform2f(glGetUniformLocation(shader_program, "view_max"), (float)view.x_max, (float)view.y_max);
+				glUniform2f(glGetUniformLocation(shader_program, "view_min"), (float)flat_view.x_min, (float)flat_view.y_min);
+				glUniform2f(glGetUniformLocation(shader_program, "view_max"), (float)flat_view.x_max, (float)flat_view.y_max);
 				glUniform3fv(glGetUniformLocation(shader_program, "color"), 1, color);
 				glActiveTexture(GL_TEXTURE0); // Ensure texture unit 0 is active
 				glBindTexture(GL_TEXTURE_2D, texture);
@@ -617,7 +659,7 @@ int main(int argc, char* argv[]) {
 				check_gl_error("pixel fractal render");
 			}
 			else {
-				render_line_fractal(shader_program, view, current_fractal, line_vao, line_vbo);
+				render_line_fractal(shader_program, flat_view, current_fractal, line_vao, line_vbo);
 			}
 		}
 
@@ -630,6 +672,7 @@ int main(int argc, char* argv[]) {
 	glDeleteVertexArrays(1, &line_vao);
 	glDeleteBuffers(1, &line_vbo);
 	glDeleteProgram(shader_program);
+	render_service.reset();
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
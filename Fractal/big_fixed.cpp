@@ -0,0 +1,156 @@
+#include "big_fixed.h"
+
+#include <algorithm>
+#include <cmath>
+
+BigFixed::BigFixed(double mantissa, int exponent, int fraction_bits)
+	: negative(mantissa < 0.0), limbs((std::max(fraction_bits, 0) + 31) / 32 + 1, 0) {
+	if (mantissa != 0.0 && std::isfinite(mantissa)) {
+		// |mantissa| = bits * 2^(e - 53) with bits a 53-bit integer
+		int e;
+		std::uint64_t bits = static_cast<std::uint64_t>(std::ldexp(std::frexp(std::fabs(mantissa), &e), 53));
+		long long shift = static_cast<long long>(e) + exponent - 53 + 32LL * fraction_limbs();
+		for (int bit = 0; bit < 53; ++bit) {
+			long long position = shift + bit;
+			if (!((bits >> bit) & 1) || position < 0 || position >= 32LL * static_cast<long long>(limbs.size())) continue;
+			limbs[static_cast<std::size_t>(position / 32)] |= 1u << (position % 32);
+		}
+	}
+	if (is_zero()) negative = false;
+}
+
+void BigFixed::set_fraction_bits(int bits) {
+	int change = (std::max(bits, 0) + 31) / 32 - fraction_limbs();
+	if (change > 0) {
+		limbs.insert(limbs.begin(), static_cast<std::size_t>(change), 0u);
+	}
+	else if (change < 0) {
+		limbs.erase(limbs.begin(), limbs.begin() - change);
+		if (is_zero()) negative = false;
+	}
+}
+
+bool BigFixed::is_zero() const {
+	for (std::uint32_t limb : limbs) {
+		if (limb) return false;
+	}
+	return true;
+}
+
+double BigFixed::scaled(int exponent) const {
+	int top = static_cast<int>(limbs.size()) - 1;
+	while (top >= 0 && !limbs[top]) --top;
+	if (top < 0) return 0.0;
+
+	double value = 0.0;
+	for (int i = top; i >= 0 && i > top - 3; --i) {
+		value += std::ldexp(static_cast<double>(limbs[i]), 32 * (i - fraction_limbs()) + exponent);
+	}
+	return negative ? -value : value;
+}
+
+BigFixed::operator DoubleDouble<double>() const {
+	double hi = scaled(0);
+	double lo = (*this - BigFixed(hi, fraction_bits())).scaled(0);
+	return DoubleDouble<double>::quick_two_sum(hi, lo);
+}
+
+std::string BigFixed::to_string(int digits) const {
+	std::string text = negative ? "-" : "";
+	text += std::to_string(limbs.back());
+	if (digits <= 0) return text;
+
+	// Digits fall out of the top of the fraction, one multiply by 10 each
+	std::vector<std::uint32_t> fraction(limbs.begin(), limbs.end() - 1);
+	text += '.';
+	for (int d = 0; d < digits; ++d) {
+		std::uint64_t carry = 0;
+		for (std::uint32_t& limb : fraction) {
+			std::uint64_t product = static_cast<std::uint64_t>(limb) * 10u + carry;
+			limb = static_cast<std::uint32_t>(product);
+			carry = product >> 32;
+		}
+		text += static_cast<char>('0' + carry);
+	}
+	return text;
+}
+
+BigFixed operator-(const BigFixed& a) {
+	BigFixed negated = a;
+	negated.negative = !a.negative && !a.is_zero();
+	return negated;
+}
+
+BigFixed operator+(const BigFixed& a, const BigFixed& b) {
+	int bits = std::max(a.fraction_bits(), b.fraction_bits());
+	BigFixed x = a, y = b;
+	x.set_fraction_bits(bits);
+	y.set_fraction_bits(bits);
+
+	if (x.negative == y.negative) {
+		std::uint64_t carry = 0;
+		for (std::size_t i = 0; i < x.limbs.size(); ++i) {
+			std::uint64_t sum = static_cast<std::uint64_t>(x.limbs[i]) + y.limbs[i] + carry;
+			x.limbs[i] = static_cast<std::uint32_t>(sum);
+			carry = sum >> 32;
+		}
+	}
+	else {
+		// Subtract the smaller magnitude from the larger; the result takes
+		// the sign of the larger
+		bool x_larger = true;
+		for (std::size_t i = x.limbs.size(); i-- > 0;) {
+			if (x.limbs[i] != y.limbs[i]) {
+				x_larger = x.limbs[i] > y.limbs[i];
+				break;
+			}
+		}
+		if (!x_larger) std::swap(x, y);
+		std::int64_t borrow = 0;
+		for (std::size_t i = 0; i < x.limbs.size(); ++i) {
+			std::int64_t difference = static_cast<std::int64_t>(x.limbs[i]) - y.limbs[i] - borrow;
+			borrow = difference < 0;
+			x.limbs[i] = static_cast<std::uint32_t>(difference + (borrow << 32));
+		}
+	}
+	if (x.is_zero()) x.negative = false;
+	return x;
+}
+
+BigFixed operator*(const BigFixed& a, const BigFixed& b) {
+	int fraction = std::max(a.fraction_limbs(), b.fraction_limbs());
+	int drop = a.fraction_limbs() + b.fraction_limbs() - fraction; // product limbs below the result's fraction
+
+	// Schoolbook, skipping the partial products that land entirely below
+	// the limbs kept (their carries are lost: the result is truncated)
+	std::vector<std::uint64_t> columns(a.limbs.size() + b.limbs.size() + 1, 0);
+	for (std::size_t i = 0; i < a.limbs.size(); ++i) {
+		if (!a.limbs[i]) continue;
+		std::size_t first = static_cast<std::size_t>(std::max(0, drop - 1 - static_cast<int>(i)));
+		for (std::size_t j = first; j < b.limbs.size(); ++j) {
+			std::uint64_t product = static_cast<std::uint64_t>(a.limbs[i]) * b.limbs[j];
+			columns[i + j] += product & 0xffffffffu;
+			columns[i + j + 1] += product >> 32;
+		}
+	}
+
+	BigFixed result;
+	result.limbs.assign(static_cast<std::size_t>(fraction) + 1, 0);
+	std::uint64_t carry = 0;
+	for (std::size_t k = 0; k < columns.size(); ++k) {
+		std::uint64_t column = columns[k] + carry;
+		int index = static_cast<int>(k) - drop;
+		if (index >= 0 && index <= fraction) result.limbs[index] = static_cast<std::uint32_t>(column);
+		carry = column >> 32;
+	}
+	result.negative = (a.negative != b.negative) && !result.is_zero();
+	return result;
+}
+
+bool operator==(const BigFixed& a, const BigFixed& b) {
+	int bits = std::max(a.fraction_bits(), b.fraction_bits());
+	BigFixed x = a, y = b;
+	x.set_fraction_bits(bits);
+	y.set_fraction_bits(bits);
+	return x.negative == y.negative && x.limbs == y.limbs;
+}
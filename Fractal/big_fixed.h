@@ -0,0 +1,58 @@
+#ifndef BIG_FIXED_H
+#define BIG_FIXED_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "double_double.h"
+
+// Signed fixed-point number with a 32-bit integer part and any number of
+// 32-bit fraction limbs, for view centres and reference orbits that need
+// more bits than double-double has. Sums are exact when both operands fit
+// the result precision (the larger of the two); products are truncated to
+// it. The integer part wraps, so keep values well inside +-2^31.
+class BigFixed {
+public:
+	BigFixed() : negative(false), limbs(1, 0) {}
+
+	// mantissa * 2^exponent, truncated to fraction_bits (rounded up to whole
+	// limbs)
+	BigFixed(double mantissa, int exponent, int fraction_bits);
+	explicit BigFixed(double value, int fraction_bits = 64) : BigFixed(value, 0, fraction_bits) {}
+
+	int fraction_bits() const { return 32 * fraction_limbs(); }
+
+	// Extends (exactly) or truncates the fraction to bits, rounded up to
+	// whole limbs.
+	void set_fraction_bits(int bits);
+
+	// The value times 2^exponent as the nearest double (truncated past 96
+	// significant bits), without overflowing or underflowing on the way.
+	double scaled(int exponent) const;
+
+	explicit operator double() const { return scaled(0); }
+	explicit operator DoubleDouble<double>() const;
+
+	// Decimal with digits places after the point (truncated)
+	std::string to_string(int digits) const;
+
+	friend BigFixed operator-(const BigFixed& a);
+	friend BigFixed operator+(const BigFixed& a, const BigFixed& b);
+	friend BigFixed operator-(const BigFixed& a, const BigFixed& b) { return a + -b; }
+	friend BigFixed operator*(const BigFixed& a, const BigFixed& b);
+	BigFixed& operator+=(const BigFixed& b) { return *this = *this + b; }
+	BigFixed& operator-=(const BigFixed& b) { return *this = *this - b; }
+
+	friend bool operator==(const BigFixed& a, const BigFixed& b);
+	friend bool operator!=(const BigFixed& a, const BigFixed& b) { return !(a == b); }
+
+private:
+	int fraction_limbs() const { return static_cast<int>(limbs.size()) - 1; }
+	bool is_zero() const;
+
+	bool negative;
+	std::vector<std::uint32_t> limbs; // magnitude, least significant first; the last is the integer part
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "cpu_features.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if CPU_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#elif CPU_X86
+#include <cpuid.h>
+#endif
+
+#if CPU_X86
+static void cpuid(unsigned regs[4], unsigned leaf, unsigned subleaf) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(info[i]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switch (XCR0)
+static unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+KernelIsa detect_kernel_isa() {
+#if CPU_X86
+	unsigned regs[4];
+	cpuid(regs, 0, 0);
+	unsigned max_leaf = regs[0];
+
+	cpuid(regs, 1, 0);
+	bool sse2 = (regs[3] >> 26) & 1;
+	bool osxsave = (regs[2] >> 27) & 1;
+	bool avx = (regs[2] >> 28) & 1;
+	if (!sse2) return ISA_SCALAR;
+	if (!osxsave || !avx || max_leaf < 7) return ISA_SSE2;
+
+	unsigned long long xcr0 = xgetbv0();
+	cpuid(regs, 7, 0);
+	bool avx2 = (regs[1] >> 5) & 1;
+	bool avx512f = (regs[1] >> 16) & 1;
+	if (!avx2 || (xcr0 & 0x6) != 0x6) return ISA_SSE2;          // XMM, YMM
+	if (!avx512f || (xcr0 & 0xe6) != 0xe6) return ISA_AVX2;     // + opmask, ZMM
+	return ISA_AVX512;
+#else
+	return ISA_SCALAR;
+#endif
+}
+
+const char* kernel_isa_name(KernelIsa isa) {
+	switch (isa) {
+	case ISA_SSE2: return "sse2";
+	case ISA_AVX2: return "avx2";
+	case ISA_AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+bool parse_kernel_isa(const char* name, KernelIsa& isa) {
+	const KernelIsa all[] = { ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_AVX512 };
+	for (KernelIsa candidate : all) {
+		if (std::strcmp(name, kernel_isa_name(candidate)) == 0) {
+			isa = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+KernelIsa resolve_kernel_isa(int argc, char* argv[]) {
+	KernelIsa best = detect_kernel_isa();
+	KernelIsa forced;
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::strcmp(argv[i], "--isa") == 0 && parse_kernel_isa(argv[i + 1], forced)) {
+			return forced < best ? forced : best;
+		}
+	}
+	if (const char* env = std::getenv("FRACTAL_ISA")) {
+		if (parse_kernel_isa(env, forced)) return forced < best ? forced : best;
+	}
+	return best;
+}
@@ -0,0 +1,29 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#else
+#define CPU_X86 0
+#endif
+
+// Instruction-set variants the fractal kernels are built for, in order of
+// preference. Each one implies the ones before it.
+enum KernelIsa {
+	ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_AVX512
+};
+
+// Best variant this CPU (and the OS, for the wider register state) supports.
+KernelIsa detect_kernel_isa();
+
+const char* kernel_isa_name(KernelIsa isa);
+
+// Parses "scalar", "sse2", "avx2" or "avx512"; false if name is none of them.
+bool parse_kernel_isa(const char* name, KernelIsa& isa);
+
+// Variant from "--isa NAME" on the command line, then the FRACTAL_ISA
+// environment variable, then detect_kernel_isa(). A forced variant the CPU
+// cannot run is lowered to the best one it can.
+KernelIsa resolve_kernel_isa(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef DOUBLE_DOUBLE_H
+#define DOUBLE_DOUBLE_H
+
+#include <limits>
+
+// Unevaluated sum hi + lo of two floating-point numbers of type T, with |lo|
+// at most half an ulp of hi: twice the mantissa of T (about 106 bits for
+// double) for a handful of T operations per add or multiply. Everything is
+// built from branch-free error-free transforms, with Dekker's split instead
+// of FMA, so loops over it vectorize and it runs on any target. The error
+// terms are only exact if the compiler does not contract a * b + c into an
+// FMA, so keep contraction off where this is used.
+template <typename T>
+struct DoubleDouble {
+	T hi, lo;
+
+	DoubleDouble() : hi(0), lo(0) {}
+	DoubleDouble(T value) : hi(value), lo(0) {}
+	DoubleDouble(T hi, T lo) : hi(hi), lo(lo) {}
+
+	// The nearest T
+	explicit operator T() const { return hi; }
+
+	// a + b as hi + lo exactly (Knuth)
+	static DoubleDouble two_sum(T a, T b) {
+		T s = a + b;
+		T v = s - a;
+		return DoubleDouble(s, (a - (s - v)) + (b - v));
+	}
+
+	// a + b as hi + lo exactly, for |a| >= |b|
+	static DoubleDouble quick_two_sum(T a, T b) {
+		T s = a + b;
+		return DoubleDouble(s, b - (s - a));
+	}
+
+	// a * b as hi + lo exactly (Dekker)
+	static DoubleDouble two_prod(T a, T b) {
+		const T splitter = T(1 << ((std::numeric_limits<T>::digits + 1) / 2)) + T(1);
+		T p = a * b;
+		T ta = splitter * a, tb = splitter * b;
+		T a_hi = ta - (ta - a), a_lo = a - a_hi;
+		T b_hi = tb - (tb - b), b_lo = b - b_hi;
+		return DoubleDouble(p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo);
+	}
+
+	friend DoubleDouble operator-(const DoubleDouble& a) { return DoubleDouble(-a.hi, -a.lo); }
+
+	friend DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) {
+		DoubleDouble s = two_sum(a.hi, b.hi);
+		DoubleDouble t = two_sum(a.lo, b.lo);
+		s = quick_two_sum(s.hi, s.lo + t.hi);
+		return quick_two_sum(s.hi, s.lo + t.lo);
+	}
+
+	friend DoubleDouble operator+(const DoubleDouble& a, T b) {
+		DoubleDouble s = two_sum(a.hi, b);
+		return quick_two_sum(s.hi, s.lo + a.lo);
+	}
+
+	friend DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) { return a + -b; }
+	friend DoubleDouble operator-(const DoubleDouble& a, T b) { return a + -b; }
+
+	friend DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) {
+		DoubleDouble p = two_prod(a.hi, b.hi);
+		return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+	}
+
+	friend DoubleDouble operator*(const DoubleDouble& a, T b) {
+		DoubleDouble p = two_prod(a.hi, b);
+		return quick_two_sum(p.hi, p.lo + a.lo * b);
+	}
+
+	// One correction step on the T quotient
+	friend DoubleDouble operator/(const DoubleDouble& a, T b) {
+		T q = a.hi / b;
+		DoubleDouble p = two_prod(q, b);
+		return quick_two_sum(q, (((a.hi - p.hi) - p.lo) + a.lo) / b);
+	}
+
+	DoubleDouble& operator+=(const DoubleDouble& b) { return *this = *this + b; }
+	DoubleDouble& operator-=(const DoubleDouble& b) { return *this = *this - b; }
+	DoubleDouble& operator*=(const DoubleDouble& b) { return *this = *this * b; }
+
+	friend bool operator==(const DoubleDouble& a, const DoubleDouble& b) { return a.hi == b.hi && a.lo == b.lo; }
+	friend bool operator!=(const DoubleDouble& a, const DoubleDouble& b) { return !(a == b); }
+};
+
+#endif
@@ -0,0 +1,406 @@
+#include "formula.h"
+
+#include <cctype>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+typedef std::complex<double> Complex;
+
+// A value while compiling: a constant that has no register yet, or the
+// register holding it
+struct Operand {
+	bool constant;
+	Complex value;
+	int reg;
+};
+
+Operand constant_operand(Complex value) { return { true, value, -1 }; }
+Operand register_operand(int reg) { return { false, Complex(), reg }; }
+
+struct Function {
+	const char* name;
+	FormulaOp op;
+};
+
+const Function functions[] = {
+	{ "sin", FORMULA_SIN }, { "cos", FORMULA_COS }, { "sinh", FORMULA_SINH }, { "cosh", FORMULA_COSH },
+	{ "exp", FORMULA_EXP }, { "log", FORMULA_LOG }, { "conj", FORMULA_CONJUGATE }, { "fold", FORMULA_FOLD },
+};
+
+Complex fold_constant(FormulaOp op, Complex a, Complex b) {
+	switch (op) {
+	case FORMULA_ADD: return a + b;
+	case FORMULA_SUB: return a - b;
+	case FORMULA_MUL: return a * b;
+	case FORMULA_DIV: return a / b;
+	case FORMULA_SQUARE: return a * a;
+	case FORMULA_NEGATE: return -a;
+	case FORMULA_CONJUGATE: return std::conj(a);
+	case FORMULA_FOLD: return Complex(std::fabs(a.real()), std::fabs(a.imag()));
+	case FORMULA_EXP: return std::exp(a);
+	case FORMULA_LOG: return std::log(a);
+	case FORMULA_SIN: return std::sin(a);
+	case FORMULA_COS: return std::cos(a);
+	case FORMULA_SINH: return std::sinh(a);
+	case FORMULA_COSH: return std::cosh(a);
+	default: return a;
+	}
+}
+
+std::string trim(const std::string& text) {
+	std::size_t begin = text.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos) return std::string();
+	return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+}
+
+// Recursive descent over the source, emitting as it goes. Temporaries are
+// taken from the top of the register file down and the constants from
+// FORMULA_CONSTANTS up; each temporary is freed by the instruction that
+// consumes it, so the register count follows the depth of the expression,
+// not its length.
+class FormulaCompiler {
+public:
+	FormulaCompiler(const std::string& source, FormulaProgram& program)
+		: source(source), program(program), at(0), end(0), code(nullptr), allow_z(true), lowest_temporary(FORMULA_REGISTERS) {}
+
+	bool compile(std::string& error) {
+		std::size_t split = source.find(';');
+		if (split != std::string::npos) {
+			if (!statement(0, split, true)) return fail_with(error);
+			if (!statement(split + 1, source.size(), false)) return fail_with(error);
+		}
+		else if (!statement(0, source.size(), false)) {
+			return fail_with(error);
+		}
+		return true;
+	}
+
+private:
+	// "z0 = expression" if start, else "z = expression" or the expression
+	bool statement(std::size_t begin, std::size_t finish, bool start) {
+		at = begin;
+		end = finish;
+		code = start ? &program.start : &program.step;
+		allow_z = !start;
+
+		std::size_t before = at;
+		std::string target = identifier();
+		skip_space();
+		if (!target.empty() && peek() == '=') {
+			++at;
+			if (target != (start ? "z0" : "z")) return fail(start ? "the first statement must set z0" : "the formula must set z");
+		}
+		else if (start) {
+			return fail("the first statement must set z0");
+		}
+		else {
+			at = before;
+		}
+
+		Operand result = expression();
+		if (!message.empty()) return false;
+		skip_space();
+		if (at < end) return fail(std::string("unexpected '") + source[at] + "'");
+		if (code->empty() && !result.constant && result.reg == FORMULA_Z) return true;
+
+		// The last instruction made the result, so it can write z instead
+		if (!result.constant && temporary(result.reg)) {
+			code->back().target = FORMULA_Z;
+			release(result);
+		}
+		else {
+			int reg = materialize(result);
+			if (!message.empty()) return false;
+			code->push_back({ FORMULA_MOVE, FORMULA_Z, static_cast<unsigned char>(reg), static_cast<unsigned char>(reg) });
+		}
+		return true;
+	}
+
+	Operand expression() {
+		Operand left = term();
+		for (;;) {
+			skip_space();
+			if (!message.empty() || (peek() != '+' && peek() != '-')) return left;
+			FormulaOp op = source[at++] == '+' ? FORMULA_ADD : FORMULA_SUB;
+			left = binary(op, left, term());
+		}
+	}
+
+	Operand term() {
+		Operand left = unary();
+		for (;;) {
+			skip_space();
+			if (!message.empty() || (peek() != '*' && peek() != '/')) return left;
+			FormulaOp op = source[at++] == '*' ? FORMULA_MUL : FORMULA_DIV;
+			left = binary(op, left, unary());
+		}
+	}
+
+	// Minus binds looser than ^, so -z^2 is -(z^2)
+	Operand unary() {
+		skip_space();
+		if (peek() == '-') {
+			++at;
+			return apply(FORMULA_NEGATE, unary());
+		}
+		if (peek() == '+') {
+			++at;
+			return unary();
+		}
+		Operand base = primary();
+		skip_space();
+		if (!message.empty() || peek() != '^') return base;
+		++at;
+		skip_space();
+		bool negative = peek() == '-';
+		if (negative) ++at;
+		if (!std::isdigit(static_cast<unsigned char>(peek()))) {
+			fail("the exponent must be a whole number");
+			return base;
+		}
+		// The whole digit run, held at 1024 once it gets there
+		int exponent = 0;
+		while (std::isdigit(static_cast<unsigned char>(peek()))) {
+			exponent = exponent * 10 + (source[at++] - '0');
+			if (exponent > 1024) exponent = 1024;
+		}
+		if (peek() == '.' || exponent >= 1024) {
+			fail("the exponent must be a whole number below 1024");
+			return base;
+		}
+		return power(base, negative ? -exponent : exponent);
+	}
+
+	Operand primary() {
+		skip_space();
+		if (peek() == '(') {
+			++at;
+			Operand inner = expression();
+			skip_space();
+			if (message.empty() && peek() != ')') fail("missing ')'");
+			++at;
+			return inner;
+		}
+		if (std::isdigit(static_cast<unsigned char>(peek())) || peek() == '.') {
+			// Decimal only: digits, a fraction, an exponent. strtod alone
+			// would also take hex and give infinities.
+			std::size_t first = at;
+			std::size_t digits = skip_digits();
+			if (peek() == '.') {
+				++at;
+				digits += skip_digits();
+			}
+			if (digits > 0 && (peek() == 'e' || peek() == 'E')) {
+				std::size_t mark = at++;
+				if (peek() == '+' || peek() == '-') ++at;
+				if (skip_digits() == 0) at = mark;
+			}
+			double value = digits > 0 ? std::strtod(source.substr(first, at - first).c_str(), nullptr) : 0.0;
+			if (digits == 0 || !std::isfinite(value)) {
+				fail("bad number");
+				return constant_operand(0.0);
+			}
+			if (peek() == 'i' && !std::isalnum(static_cast<unsigned char>(peek(1)))) {
+				++at;
+				return constant_operand(Complex(0.0, value));
+			}
+			return constant_operand(value);
+		}
+
+		std::size_t position = at;
+		std::string name = identifier();
+		if (name.empty()) {
+			fail(at < end ? std::string("unexpected '") + source[at] + "'" : std::string("unexpected end"));
+			return constant_operand(0.0);
+		}
+		if (name == "i") return constant_operand(Complex(0.0, 1.0));
+		if (name == "c") return register_operand(FORMULA_C);
+		if (name == "z") {
+			if (!allow_z) fail("z0 cannot depend on z");
+			return register_operand(FORMULA_Z);
+		}
+		for (const Function& function : functions) {
+			if (name != function.name) continue;
+			skip_space();
+			if (peek() != '(') {
+				fail("missing '(' after " + name);
+				return constant_operand(0.0);
+			}
+			return apply(function.op, primary());
+		}
+		at = position;
+		fail("unknown name '" + name + "'");
+		return constant_operand(0.0);
+	}
+
+	Operand binary(FormulaOp op, Operand a, Operand b) {
+		if (!message.empty()) return a;
+		if (a.constant && b.constant) return constant_operand(fold_constant(op, a.value, b.value));
+		int ra = materialize(a), rb = materialize(b);
+		release(a);
+		release(b);
+		return register_operand(emit(op, ra, rb));
+	}
+
+	Operand apply(FormulaOp op, Operand a) {
+		if (!message.empty()) return a;
+		if (a.constant) return constant_operand(fold_constant(op, a.value, Complex()));
+		release(a);
+		return register_operand(emit(op, a.reg, a.reg));
+	}
+
+	// Square and multiply, from the top bit of the exponent down
+	Operand power(Operand base, int exponent) {
+		if (!message.empty()) return base;
+		int magnitude = exponent < 0 ? -exponent : exponent;
+		if (base.constant) {
+			Complex value = 1.0;
+			for (int k = 0; k < magnitude; ++k) value *= base.value;
+			return constant_operand(exponent < 0 ? 1.0 / value : value);
+		}
+		if (magnitude == 0) {
+			release(base);
+			return constant_operand(1.0);
+		}
+
+		int top = 0;
+		while (magnitude >> (top + 1)) ++top;
+		Operand result = base;
+		for (int bit = top - 1; bit >= 0 && message.empty(); --bit) {
+			if (result.reg != base.reg) release(result);
+			result = register_operand(emit(FORMULA_SQUARE, result.reg, result.reg));
+			if ((magnitude >> bit) & 1) {
+				release(result);
+				result = register_operand(emit(FORMULA_MUL, result.reg, base.reg));
+			}
+		}
+		if (result.reg != base.reg) release(base);
+		return exponent < 0 ? binary(FORMULA_DIV, constant_operand(1.0), result) : result;
+	}
+
+	int emit(FormulaOp op, int a, int b) {
+		int target = allocate();
+		code->push_back({ op, static_cast<unsigned char>(target), static_cast<unsigned char>(a), static_cast<unsigned char>(b) });
+		return target;
+	}
+
+	// The register of a, giving a constant one (shared between equal values)
+	int materialize(const Operand& a) {
+		if (!a.constant) return a.reg;
+		int count = static_cast<int>(program.constant_real.size());
+		for (int k = 0; k < count; ++k) {
+			if (program.constant_real[k] == a.value.real() && program.constant_imag[k] == a.value.imag()) return FORMULA_CONSTANTS + k;
+		}
+		if (FORMULA_CONSTANTS + count >= lowest_temporary) return too_long();
+		program.constant_real.push_back(a.value.real());
+		program.constant_imag.push_back(a.value.imag());
+		return FORMULA_CONSTANTS + count;
+	}
+
+	int allocate() {
+		if (!free_temporaries.empty()) {
+			int reg = free_temporaries.back();
+			free_temporaries.pop_back();
+			return reg;
+		}
+		if (lowest_temporary - 1 < FORMULA_CONSTANTS + static_cast<int>(program.constant_real.size())) return too_long();
+		return --lowest_temporary;
+	}
+
+	bool temporary(int reg) const { return reg >= lowest_temporary; }
+
+	void release(const Operand& a) {
+		if (!a.constant && temporary(a.reg)) free_temporaries.push_back(a.reg);
+	}
+
+	int too_long() {
+		fail("the formula needs more than " + std::to_string(FORMULA_REGISTERS) + " registers");
+		return FORMULA_Z;
+	}
+
+	std::string identifier() {
+		skip_space();
+		std::size_t begin = at;
+		if (!std::isalpha(static_cast<unsigned char>(peek()))) return std::string();
+		while (std::isalnum(static_cast<unsigned char>(peek()))) ++at;
+		return source.substr(begin, at - begin);
+	}
+
+	void skip_space() {
+		while (at < end && std::isspace(static_cast<unsigned char>(source[at]))) ++at;
+	}
+
+	// Number of digits skipped
+	std::size_t skip_digits() {
+		std::size_t first = at;
+		while (std::isdigit(static_cast<unsigned char>(peek()))) ++at;
+		return at - first;
+	}
+
+	char peek(std::size_t ahead = 0) const { return at + ahead < end ? source[at + ahead] : '\0'; }
+
+	bool fail(const std::string& text) {
+		if (message.empty()) message = text + " at column " + std::to_string(at + 1);
+		return false;
+	}
+
+	bool fail_with(std::string& error) {
+		error = message;
+		return false;
+	}
+
+	const std::string& source;
+	FormulaProgram& program;
+	std::size_t at, end; // position in source, and the end of the statement
+	std::vector<FormulaInstruction>* code;
+	bool allow_z;
+	int lowest_temporary;
+	std::vector<int> free_temporaries;
+	std::string message; // the first error
+};
+
+bool FormulaProgram::compile(const std::string& name, const std::string& source, FormulaProgram& program, std::string& error) {
+	FormulaProgram compiled;
+	compiled.program_name = name;
+	compiled.program_source = source;
+	FormulaCompiler compiler(compiled.program_source, compiled);
+	if (!compiler.compile(error)) return false;
+	program = compiled;
+	return true;
+}
+
+FormulaCode FormulaProgram::code() const {
+	FormulaCode code = {
+		start.data(), static_cast<int>(start.size()),
+		step.data(), static_cast<int>(step.size()),
+		constant_real.data(), constant_imag.data(), static_cast<int>(constant_real.size()),
+	};
+	return code;
+}
+
+bool load_formulas(const char* path, std::vector<std::shared_ptr<const FormulaProgram>>& formulas, std::vector<std::string>& errors) {
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	std::string line;
+	for (int number = 1; std::getline(file, line); ++number) {
+		line = trim(line);
+		if (line.empty() || line[0] == '#') continue;
+		std::size_t colon = line.find(':');
+		std::string name = colon == std::string::npos ? line : trim(line.substr(0, colon));
+		std::string source = colon == std::string::npos ? line : trim(line.substr(colon + 1));
+
+		std::shared_ptr<FormulaProgram> program = std::make_shared<FormulaProgram>();
+		std::string error;
+		if (!FormulaProgram::compile(name, source, *program, error)) {
+			errors.push_back(std::string(path) + ":" + std::to_string(number) + ": " + name + ": " + error);
+			continue;
+		}
+		formulas.push_back(program);
+	}
+	return true;
+}
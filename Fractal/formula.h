@@ -0,0 +1,45 @@
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "math.h"
+
+// A user-defined escape-time fractal, compiled from text such as
+// "z = z^3 + c*sin(z)" into the register bytecode evaluate_block runs for
+// USER_FORMULA (see FormulaCode in math.h).
+//
+// The source is the step "z = ..." (or just its right-hand side), which
+// gives the next z from z and c, optionally preceded by "z0 = ...;", which
+// gives the first z from c (0 if left out). Expressions have + - * /,
+// unary minus, ^ with a whole exponent between -1024 and 1024 (exclusive),
+// parentheses, z, c, decimal numbers (as in 2, .5 or 1e-3), i (also as in
+// 2.5i) and the functions sin, cos, sinh, cosh, exp, log, conj and fold
+// (|Re| + i |Im|). Constant parts are folded.
+class FormulaProgram {
+public:
+	// Compiles source into program. Returns false, with the reason in
+	// error, if it does not parse or needs more than FORMULA_REGISTERS.
+	static bool compile(const std::string& name, const std::string& source, FormulaProgram& program, std::string& error);
+
+	const std::string& name() const { return program_name; }
+	const std::string& source() const { return program_source; }
+	FormulaCode code() const;
+
+private:
+	friend class FormulaCompiler;
+
+	std::string program_name, program_source;
+	std::vector<FormulaInstruction> start, step;
+	std::vector<double> constant_real, constant_imag;
+};
+
+// Reads the formulas of a config file: one "name: source" per line, or
+// just the source, which then names itself. Blank lines and lines starting
+// with # are skipped, and so are lines that do not compile, with a message
+// in errors. Returns false if the file cannot be opened.
+bool load_formulas(const char* path, std::vector<std::shared_ptr<const FormulaProgram>>& formulas, std::vector<std::string>& errors);
+
+#endif
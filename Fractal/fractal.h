@@ -0,0 +1,30 @@
+#ifndef FRACTAL_H
+#define FRACTAL_H
+
+#include <memory>
+
+#include "kernels.h"
+#include "viewport.h"
+
+class FormulaProgram;
+
+// Everything that determines the content of a frame.
+struct RenderKey {
+	FractalType type;
+	Viewport view;
+	int iterations;
+	int width, height;
+	Precision precision = PRECISION_AUTO;
+	bool subdivide = false; // Mariani-Silver: fill rectangles whose border is all one value
+	std::shared_ptr<const FormulaProgram> formula; // the program of USER_FORMULA
+	bool distance = false; // show distance estimates instead of iteration counts where the fractal has them
+};
+
+inline bool operator==(const RenderKey& a, const RenderKey& b) {
+	return a.type == b.type && a.view == b.view && a.iterations == b.iterations &&
+		a.width == b.width && a.height == b.height && a.precision == b.precision &&
+		a.subdivide == b.subdivide && a.formula == b.formula && a.distance == b.distance;
+}
+inline bool operator!=(const RenderKey& a, const RenderKey& b) { return !(a == b); }
+
+#endif
@@ -0,0 +1,34 @@
+#include "frame_cache.h"
+
+#include <iterator>
+
+const FrameBuffer* FrameCache::find(const RenderKey& key) {
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (it->first == key) {
+			entries.splice(entries.begin(), entries, it);
+			return &entries.front().second;
+		}
+	}
+	return nullptr;
+}
+
+void FrameCache::store(const RenderKey& key, const FrameBuffer& frame) {
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (it->first == key) {
+			it->second = frame;
+			entries.splice(entries.begin(), entries, it);
+			return;
+		}
+	}
+	if (capacity == 0) return;
+
+	// Recycle the oldest entry's storage instead of allocating a new frame
+	if (entries.size() >= capacity) {
+		entries.splice(entries.begin(), entries, std::prev(entries.end()));
+		entries.front().first = key;
+		entries.front().second = frame;
+	}
+	else {
+		entries.emplace_front(key, frame);
+	}
+}
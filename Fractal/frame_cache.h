@@ -0,0 +1,32 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <utility>
+
+#include "fractal.h"
+#include "framebuffer.h"
+
+#define FRAME_CACHE_CAPACITY 8
+
+// Small LRU of finished frames keyed on everything that affects their
+// content, so flipping back to a recent view is a copy, not a render.
+class FrameCache {
+public:
+	explicit FrameCache(std::size_t capacity = FRAME_CACHE_CAPACITY) : capacity(capacity) {}
+
+	// Cached frame for key (and marks it most recently used), or nullptr.
+	const FrameBuffer* find(const RenderKey& key);
+
+	// Stores a copy of frame under key, evicting the least recently used.
+	void store(const RenderKey& key, const FrameBuffer& frame);
+
+	void clear() { entries.clear(); }
+
+private:
+	std::list<std::pair<RenderKey, FrameBuffer>> entries; // most recently used first
+	std::size_t capacity;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+static const int FLOATS_PER_LINE = FRAMEBUFFER_ALIGNMENT / sizeof(float);
+
+FrameBuffer::FrameBuffer(int width, int height)
+	: w(width), h(height),
+	row_stride((width + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE),
+	storage(static_cast<std::size_t>(row_stride) * height + FLOATS_PER_LINE, 0.0f),
+	base(nullptr) {
+	rebase();
+}
+
+FrameBuffer::FrameBuffer(const FrameBuffer& other)
+	: w(other.w), h(other.h), row_stride(other.row_stride),
+	storage(other.storage.size(), 0.0f), base(nullptr) {
+	rebase();
+	std::copy(other.base, other.base + static_cast<std::size_t>(row_stride) * h, base);
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other) {
+	if (this != &other) {
+		if (storage.size() != other.storage.size()) {
+			storage.assign(other.storage.size(), 0.0f);
+		}
+		w = other.w;
+		h = other.h;
+		row_stride = other.row_stride;
+		rebase();
+		std::copy(other.base, other.base + static_cast<std::size_t>(row_stride) * h, base);
+	}
+	return *this;
+}
+
+// The vector is over-allocated by one cache line; base is the first aligned
+// float inside it.
+void FrameBuffer::rebase() {
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(storage.data());
+	std::uintptr_t aligned = (address + FRAMEBUFFER_ALIGNMENT - 1) & ~static_cast<std::uintptr_t>(FRAMEBUFFER_ALIGNMENT - 1);
+	base = storage.data() + (aligned - address) / sizeof(float);
+}
+
+void FrameBuffer::fill(float value) {
+	std::fill(base, base + static_cast<std::size_t>(row_stride) * h, value);
+}
+
+void FrameBuffer::shift_from(const FrameBuffer& source, int dx, int dy) {
+	int x_begin = std::max(0, -dx);
+	int x_end = std::min(w, source.w - dx);
+	int y_begin = std::max(0, -dy);
+	int y_end = std::min(h, source.h - dy);
+	if (x_begin >= x_end) return;
+
+	// Walk rows so an in-place shift never reads a row it already overwrote
+	std::size_t bytes = static_cast<std::size_t>(x_end - x_begin) * sizeof(float);
+	if (dy >= 0) {
+		for (int y = y_begin; y < y_end; ++y) {
+			std::memmove(row(y) + x_begin, source.row(y + dy) + x_begin + dx, bytes);
+		}
+	}
+	else {
+		for (int y = y_end - 1; y >= y_begin; --y) {
+			std::memmove(row(y) + x_begin, source.row(y + dy) + x_begin + dx, bytes);
+		}
+	}
+}
+
+DoubleBuffer::DoubleBuffer(int width, int height)
+	: buffers{ FrameBuffer(width, height), FrameBuffer(width, height) } {
+}
@@ -0,0 +1,59 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#define FRAMEBUFFER_ALIGNMENT 64 // bytes, one cache line
+
+// One contiguous scalar field (one float per pixel, row-major).
+// Every row starts on a cache line, so workers writing disjoint rows or
+// tiles never share a line and need no locking.
+class FrameBuffer {
+public:
+	FrameBuffer(int width, int height);
+
+	int width() const { return w; }
+	int height() const { return h; }
+	int stride() const { return row_stride; } // in floats, >= width
+
+	float* data() { return base; }
+	const float* data() const { return base; }
+	float* row(int y) { return base + static_cast<std::size_t>(y) * row_stride; }
+	const float* row(int y) const { return base + static_cast<std::size_t>(y) * row_stride; }
+
+	void fill(float value);
+
+	// Copies source shifted by (dx, dy) pixels: this(x, y) = source(x + dx, y + dy).
+	// Pixels whose source falls outside the frame are left untouched.
+	void shift_from(const FrameBuffer& source, int dx, int dy);
+
+	FrameBuffer(const FrameBuffer& other);
+	FrameBuffer& operator=(const FrameBuffer& other);
+
+private:
+	void rebase();
+
+	int w;
+	int h;
+	int row_stride;
+	std::vector<float> storage;
+	float* base;
+};
+
+// Front/back pair: workers render into back() while the GL upload reads the
+// last finished frame from front(). swap() publishes the back buffer.
+class DoubleBuffer {
+public:
+	DoubleBuffer(int width, int height);
+
+	FrameBuffer& front() { return buffers[current]; }
+	FrameBuffer& back() { return buffers[current ^ 1]; }
+	void swap() { current ^= 1; }
+
+private:
+	FrameBuffer buffers[2];
+	int current = 0;
+};
+
+#endif
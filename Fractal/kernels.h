@@ -0,0 +1,159 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+#include "cpu_features.h"
+
+// What the instruction-set variants of the kernels (math_sse2.cpp,
+// math_avx2.cpp, math_avx512.cpp) see of the program: plain enums, structs
+// and declarations. MSVC compiles a whole translation unit for its /arch,
+// so any inline function or template those files instantiate, standard
+// library ones included, could be kept by the linker in a copy the CPU
+// cannot run. Nothing with inline code belongs in here; the rest of the
+// interface is in math.h.
+
+enum FractalType {
+	MANDELBROT, KOCH, SIERPINSKI_CARPET, CANTOR, DRAGON, PEANO, HILBERT,
+	SIERPINSKI_TRIANGLE, BOX, LEVY, GOSPER, CESARO, CANTOR_TERNARY,
+	KOCH_SNOWFLAKE, SIERPINSKI_ARROWHEAD, QUADRIC_KOCH, MINKOWSKI,
+	MOORE, SIERPINSKI_HEXAGON, CANTOR_MAZE, KOCH_ANTI_SNOWFLAKE, PEANO_MEANDER,
+	TERDRAGON, VICSEK, KOCH_ISLAND, HEXAFLAKE, HEIGHWAY_DRAGON, SNOWFLAKE_SWEEP,
+	CANTOR_SQUARE, HILBERT_VARIANT, SIERPINSKI_PENTAGON, DEKKING, GOSPER_ISLAND,
+	SIERPINSKI_SQUARE, KOCH_QUADRATIC, CANTOR_CLOUD,
+	JULIA, MULTIBROT, BURNING_SHIP, TRICORN, USER_FORMULA
+};
+
+// Arithmetic for escape-time fractals. AUTO picks the cheapest one that
+// still resolves the pixels of the view. PERTURBATION iterates each pixel
+// as a double offset from a high-precision reference orbit (Mandelbrot).
+enum Precision {
+	PRECISION_AUTO, PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_DOUBLE_DOUBLE, PRECISION_PERTURBATION
+};
+
+// The c every pixel of the JULIA fractal shares: just outside the
+// Mandelbrot set's period-2 bulb, so the set is a dust of spiral islands
+#define JULIA_REAL -0.8
+#define JULIA_IMAG 0.156
+
+#define DISTANCE_ESCAPE 1e6   // |z|^2 distance estimates are taken at; the larger, the closer they come to a lower bound
+#define DISTANCE_MAX_STEPS 16 // steps past the escape test at most to get there
+#define DISTANCE_FALLOFF 4.0  // pixels from the boundary over which distance output fades to 0
+
+#define PERTURBATION_TOLERANCE 1e-6 // |Z + dz|^2 below this fraction of |Z|^2 marks a glitch
+
+// Orbit of a perturbation reference point C as doubles: the length values
+// Z_0 = 0, Z_{n+1} = Z_n^2 + C up to the first that escapes or the
+// iteration cap. glitch[n] is PERTURBATION_TOLERANCE * |Z_n|^2.
+struct ReferenceOrbit {
+    const double* real;
+    const double* imag;
+    const double* glitch;
+    int length;
+};
+
+enum EscapeStatus {
+    ESCAPE_RUNNING,  // z is the orbit after iteration steps
+    ESCAPE_ESCAPED,  // escaped on step iteration
+    ESCAPE_INTERIOR, // provably never escapes (main bulbs or a cycle)
+};
+
+// How far the Mandelbrot orbit of one sample has got, so a higher cap can
+// carry on from it instead of starting from z = 0, and a lower one needs
+// no iterating at all. All zeros is an orbit not started yet.
+struct EscapeState {
+    double real, imag;
+    int iteration;
+    EscapeStatus status;
+};
+
+#define FORMULA_LANES 8      // samples the formula interpreter runs each instruction across
+#define FORMULA_REGISTERS 32 // complex registers of a formula, z and c included
+#define FORMULA_Z 0          // register of z; a program leaves its result there
+#define FORMULA_C 1          // register of c
+#define FORMULA_CONSTANTS 2  // first register of the constants, in the order of FormulaCode
+
+// Instructions of a user formula (see formula.h). Each sets register
+// target to op of registers a and b in complex arithmetic, reading both
+// before it writes, so the target may be one of them. FOLD is |Re| + i |Im|
+// and LOG the principal branch.
+enum FormulaOp {
+    FORMULA_MOVE, FORMULA_ADD, FORMULA_SUB, FORMULA_MUL, FORMULA_DIV,
+    FORMULA_SQUARE, FORMULA_NEGATE, FORMULA_CONJUGATE, FORMULA_FOLD,
+    FORMULA_EXP, FORMULA_LOG, FORMULA_SIN, FORMULA_COS, FORMULA_SINH, FORMULA_COSH,
+};
+
+struct FormulaInstruction {
+    FormulaOp op;
+    unsigned char target, a, b;
+};
+
+// A compiled formula as the kernels run it: z starts as start (run with c
+// set and z = 0; no instructions leaves z = 0), each iteration runs step,
+// and the sample escapes once |z|^2 > 4, or z stops being finite.
+struct FormulaCode {
+    const FormulaInstruction* start;
+    int start_length;
+    const FormulaInstruction* step;
+    int step_length;
+    const double* constant_real;
+    const double* constant_imag;
+    int constants;
+};
+
+// Sample positions of a block: the columns x rows grid at
+// (real[i * step_x], imag[j * step_y]). real_lo and imag_lo, when set, hold
+// the low parts of the coordinates for the double-double tier. With a
+// reference orbit the positions are offsets from its point. state, when
+// set, is at the same offsets as the output: the float and double
+// Mandelbrot kernels start each sample from it and leave it where they
+// stopped (the other tiers and fractals ignore it). formula is the program
+// of USER_FORMULA.
+//
+// distance, when set, has the Mandelbrot set, the Julia set and the
+// Multibrot estimate distances (see mandelbrot_distance in math.h) instead of
+// counting iterations: each sample's estimate in units of pixel goes to
+// distance, at the same offsets as the output, and the output fades from 1
+// on the boundary (and inside) to 0 DISTANCE_FALLOFF pixels out. They then
+// run in double at least, and ignore state.
+struct SampleGrid {
+    const double* real;
+    const double* real_lo;
+    int columns, step_x;
+    const double* imag;
+    const double* imag_lo;
+    int rows, step_y;
+    const ReferenceOrbit* reference;
+    EscapeState* state;
+    const FormulaCode* formula;
+    float* distance;
+    double pixel;
+};
+
+// Interior short-cuts in the direct escape-time kernels: points in the
+// main cardioid or the period-2 bulb, and orbits that are found to cycle,
+// stop as bounded instead of running to the cap. The output is the same
+// either way; on by default, off to measure what it saves.
+void set_interior_checks(bool enabled);
+bool interior_checks();
+
+// The per-variant builds evaluate_span and evaluate_block dispatch to
+// (math_sse2.cpp, math_avx2.cpp, math_avx512.cpp); only call the ones the
+// CPU supports.
+#if CPU_X86
+void evaluate_span_sse2(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out);
+void evaluate_span_avx2(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out);
+void evaluate_span_avx512(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out);
+void evaluate_block_sse2(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+void evaluate_block_avx2(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+void evaluate_block_avx512(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+
+// Whether the AVX2 and AVX-512 variants were compiled for their
+// instruction sets. An MSVC configuration without the matching /arch
+// builds them from the scalar loops instead, and select_kernel_isa passes
+// them over.
+bool avx2_kernels_native();
+bool avx512_kernels_native();
+#endif
+
+#endif
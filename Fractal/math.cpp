@@ -1,23 +1,17 @@
+#include <algorithm>
 #include <complex>
 #include <vector>
 #include <cmath>
+#include <atomic>
 #include <cassert>
+#include <cfloat>
+#include <cstdlib>
+#include <limits>
 
+#include "math.h"
 
-#define M_PI 3.14159265358979
 
-float mandelbrot(double real, double imag) {
-    std::complex<double> c(real, imag);
-    std::complex<double> z(0.0, 0.0);
-    int max_iter = 50;
-    for (int i = 0; i < max_iter; ++i) {
-        z = z * z + c;
-        if (std::abs(z) > 2.0) {
-            return static_cast<float>(i) / max_iter;
-        }
-    }
-    return 1.0f;
-}
+#define M_PI 3.14159265358979
 
 std::vector<std::complex<double>> generate_koch_curve(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -39,45 +33,6 @@ std::vector<std::complex<double>> generate_koch_curve(int iterations) {
 }
 
 
- 
- 
-
-float sierpinski_carpet(double x, double y, int iterations) {
-
-    assert(iterations >= 0 && iterations <= 100000); // Sanity check 
-
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if (xi == 1 && yi == 1) return 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return 1.0f;
-}
-
-float cantor_dust(double x, double y, int iterations) {
-
-    assert(iterations >= 0 && iterations <= 100000); // Sanity check 
-
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if (xi == 1 || yi == 1) value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
-
-
 std::vector<std::complex<double>> generate_dragon_curve(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
     for (int i = 0; i < iterations; ++i) {
@@ -114,83 +69,6 @@ std::vector<std::complex<double>> generate_levy_curve(int iterations) {
     return points;
 }
 
-float peano_curve(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    int n = 1 << iterations;
-    int index = 0;
-    for (int i = 0; i < iterations; ++i) {
-        int rx = static_cast<int>(x * 3);
-        int ry = static_cast<int>(y * 3);
-        index = index * 9 + (ry * 3 + rx);
-        x = (x * 3) - rx;
-        y = (y * 3) - ry;
-    }
-    return index / static_cast<float>(n * n);
-}
-
-float hilbert_curve(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    int n = 1 << iterations;
-    int index = 0;
-    for (int i = 0; i < iterations; ++i) {
-        int rx = static_cast<int>(x * 2);
-        int ry = static_cast<int>(y * 2);
-        index = index * 4 + ((rx ^ ry) * 2 + rx);
-        x = (x * 2) - rx;
-        y = (y * 2) - ry;
-    }
-    return index / static_cast<float>(n * n);
-}
-
-float sierpinski_triangle(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1 || y > 1 - x) return 0.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 2);
-        int yi = static_cast<int>(y * 2);
-        if (xi + yi >= 2) return 0.0f;
-        x = (x * 2) - xi;
-        y = (y * 2) - yi;
-    }
-    return 1.0f;
-}
-
-float box_fractal(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if ((xi == 0 || xi == 2) && (yi == 0 || yi == 2)) value *= 1.0f;
-        else value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
-
-
-float cantor_ternary_grid(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if (xi == 1 && yi == 1) value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
 
 std::vector<std::complex<double>> generate_gosper_curve(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -311,7 +189,6 @@ std::vector<std::complex<double>> generate_quadric_koch(int iterations) {
 }
 
 
-
 std::vector<std::complex<double>> generate_minkowski_sausage(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
     for (int i = 0; i < iterations; ++i) {
@@ -336,67 +213,6 @@ std::vector<std::complex<double>> generate_minkowski_sausage(int iterations) {
     return points;
 }
 
-float moore_curve(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    int n = 1 << iterations;
-    int index = 0;
-    for (int i = 0; i < iterations; ++i) {
-        int rx = static_cast<int>(x * 2);
-        int ry = static_cast<int>(y * 2);
-        int quadrant = (rx ^ ry) * 2 + rx;
-        if (i % 2 == 0) quadrant = (quadrant + 1) % 4;
-        index = index * 4 + quadrant;
-        x = (x * 2) - rx;
-        y = (y * 2) - ry;
-    }
-    return index / static_cast<float>(n * n);
-}
-
-float sierpinski_hexagon(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
-    double cx = 0.5, cy = std::sqrt(3.0) / 4.0;
-    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
-    if (r > std::sqrt(3.0) / 2.0) return 0.0f;
-    for (int i = 0; i < iterations; ++i) {
-        double scale = 3.0;
-        int closest = 0;
-        double min_dist = std::numeric_limits<double>::max();
-        for (int j = 0; j < 6; ++j) {
-            double angle = j * M_PI / 3.0;
-            double hx = cx + std::cos(angle) * std::sqrt(3.0) / (2.0 * scale);
-            double hy = cy + std::sin(angle) * std::sqrt(3.0) / (2.0 * scale);
-            double dist = std::sqrt((x - hx) * (x - hx) + (y - hy) * (y - hy));
-            if (dist < min_dist) {
-                min_dist = dist;
-                closest = j;
-            }
-        }
-        if (closest == 0 && min_dist < std::sqrt(3.0) / (6.0 * scale)) return 0.0f;
-        double angle = closest * M_PI / 3.0;
-        x = (x - cx) * scale + cx - std::cos(angle) * std::sqrt(3.0) / 2.0;
-        y = (y - cy) * scale + cy - std::sin(angle) * std::sqrt(3.0) / 2.0;
-    }
-    return 1.0f;
-}
-
-float cantor_maze(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if ((xi == 1 || yi == 1) && !(xi == 1 && yi == 1)) value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
 
 std::vector<std::complex<double>> generate_koch_anti_snowflake(int iterations) {
     double side = 1.0;
@@ -426,24 +242,6 @@ std::vector<std::complex<double>> generate_koch_anti_snowflake(int iterations) {
     return points;
 }
 
-float peano_meander_curve(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    int n = 1 << iterations;
-    int index = 0;
-    for (int i = 0; i < iterations; ++i) {
-        int rx = static_cast<int>(x * 3);
-        int ry = static_cast<int>(y * 3);
-        int quadrant = (ry * 3 + rx);
-        if (i % 2 == 1) quadrant = (9 - quadrant) % 9;
-        index = index * 9 + quadrant;
-        x = (x * 3) - rx;
-        y = (y * 3) - ry;
-    }
-    return index / static_cast<float>(n * n);
-}
-
 
 std::vector<std::complex<double>> generate_terdragon_curve(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -465,21 +263,6 @@ std::vector<std::complex<double>> generate_terdragon_curve(int iterations) {
     return points;
 }
 
-float vicsek_fractal(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if ((xi == 1 && yi != 1) || (yi == 1 && xi != 1) || (xi == 1 && yi == 1)) value *= 1.0f;
-        else value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
 
 std::vector<std::complex<double>> generate_koch_island(int iterations) {
     std::vector<std::complex<double>> points = {
@@ -504,35 +287,6 @@ std::vector<std::complex<double>> generate_koch_island(int iterations) {
     return points;
 }
 
-float hexaflake(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
-    double cx = 0.5, cy = std::sqrt(3.0) / 4.0;
-    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
-    if (r > std::sqrt(3.0) / 2.0) return 0.0f;
-    for (int i = 0; i < iterations; ++i) {
-        double scale = 3.0;
-        int closest = 0;
-        double min_dist = std::numeric_limits<double>::max();
-        for (int j = 0; j < 7; ++j) {
-            double angle = (j == 0) ? 0 : (j - 1) * M_PI / 3.0;
-            double hx = cx + (j == 0 ? 0 : std::cos(angle) * std::sqrt(3.0) / (3.0 * scale));
-            double hy = cy + (j == 0 ? 0 : std::sin(angle) * std::sqrt(3.0) / (3.0 * scale));
-            double dist = std::sqrt((x - hx) * (x - hx) + (y - hy) * (y - hy));
-            if (dist < min_dist) {
-                min_dist = dist;
-                closest = j;
-            }
-        }
-        if (closest == 0) return 1.0f;
-        double angle = (closest - 1) * M_PI / 3.0;
-        x = (x - cx) * scale + cx - std::cos(angle) * std::sqrt(3.0) / 3.0;
-        y = (y - cy) * scale + cy - std::sin(angle) * std::sqrt(3.0) / 3.0;
-    }
-    return 1.0f;
-}
-
 
 std::vector<std::complex<double>> generate_heighway_dragon_variant(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -577,68 +331,6 @@ std::vector<std::complex<double>> generate_snowflake_sweep(int iterations) {
     return points;
 }
 
-float cantor_square(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if (!(xi == 0 || xi == 2) || !(yi == 0 || yi == 2)) value *= 0.0f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
-
-float hilbert_variant(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    int n = 1 << iterations;
-    int index = 0;
-    for (int i = 0; i < iterations; ++i) {
-        int rx = static_cast<int>(x * 2);
-        int ry = static_cast<int>(y * 2);
-        int quadrant = (rx * 2 + ry);
-        if (i % 2 == 1) quadrant = (3 - quadrant) % 4;
-        index = index * 4 + quadrant;
-        x = (x * 2) - rx;
-        y = (y * 2) - ry;
-    }
-    return index / static_cast<float>(n * n);
-}
-
-float sierpinski_pentagon(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
-    double cx = 0.5, cy = 0.5 * std::tan(M_PI / 5.0);
-    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
-    if (r > std::sin(2.0 * M_PI / 5.0) / (2.0 * std::cos(M_PI / 5.0))) return 0.0f;
-    for (int i = 0; i < iterations; ++i) {
-        double scale = 2.0 + std::cos(2.0 * M_PI / 5.0);
-        int closest = 0;
-        double min_dist = std::numeric_limits<double>::max();
-        for (int j = 0; j < 6; ++j) {
-            double angle = j * 2.0 * M_PI / 5.0;
-            double px = cx + (j == 0 ? 0 : std::cos(angle) * std::sin(2.0 * M_PI / 5.0) / scale);
-            double py = cy + (j == 0 ? 0 : std::sin(angle) * std::sin(2.0 * M_PI / 5.0) / scale);
-            double dist = std::sqrt((x - px) * (x - px) + (y - py) * (y - py));
-            if (dist < min_dist) {
-                min_dist = dist;
-                closest = j;
-            }
-        }
-        if (closest == 0) return 0.0f;
-        double angle = (closest - 1) * 2.0 * M_PI / 5.0;
-        x = (x - cx) * scale + cx - std::cos(angle) * std::sin(2.0 * M_PI / 5.0) / scale;
-        y = (y - cy) * scale + cy - std::sin(angle) * std::sin(2.0 * M_PI / 5.0) / scale;
-    }
-    return 1.0f;
-}
-
 
 std::vector<std::complex<double>> generate_dekking_curve(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -688,20 +380,6 @@ std::vector<std::complex<double>> generate_gosper_island(int iterations) {
     return points;
 }
 
-float sierpinski_square(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 5);
-        int yi = static_cast<int>(y * 5);
-        if (xi == 2 && yi == 2) return 0.0f;
-        x = (x * 5) - xi;
-        y = (y * 5) - yi;
-    }
-    return value;
-}
 
 std::vector<std::complex<double>> generate_koch_quadratic(int iterations) {
     std::vector<std::complex<double>> points = { {0.0, 0.0}, {1.0, 0.0} };
@@ -728,23 +406,6 @@ std::vector<std::complex<double>> generate_koch_quadratic(int iterations) {
     return points;
 }
 
-float cantor_cloud(double x, double y, int iterations) {
-    x = (x - 0.0) / (1.0 - 0.0);
-    y = (y - 0.0) / (1.0 - 0.0);
-    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
-    float value = 1.0f;
-    for (int i = 0; i < iterations; ++i) {
-        int xi = static_cast<int>(x * 3);
-        int yi = static_cast<int>(y * 3);
-        if (xi == 1 && yi == 1) value *= 0.0f;
-        else if ((xi == 1 || yi == 1) && (rand() % 2)) value *= 0.5f;
-        x = (x * 3) - xi;
-        y = (y * 3) - yi;
-    }
-    return value;
-}
-
-
 
 float koch_curve(double x, double y, int iterations) {
     auto points = generate_koch_curve(iterations);
@@ -937,5 +598,398 @@ float koch_quadratic(double x, double y, int iterations) {
 
 
 
+// Pixel fractals: the baseline build of the kernels, also behind the
+// point-test functions declared in math.h
+namespace scalar_kernels {
+#include "pixel_kernels.inl"
+
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, double, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, float>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_grid<Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<ScalarOps<double> >(grid, iterations, out, out_stride);
+}
+}
+
+// Double-double tier (see double_double.h): scalar, and contraction must
+// stay off for its error terms to be exact.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace {
+// in_main_bulbs in double-double, so it holds as close to the boundary as
+// the views that need this tier
+bool in_main_bulbs_dd(const Coordinate& real, const Coordinate& imag) {
+    Coordinate x = real - 0.25, y2 = imag * imag;
+    Coordinate q = x * x + y2;
+    if ((q * (q + x) - y2 * 0.25).hi <= 0.0) return true;
+    Coordinate b = real + 1.0;
+    return (b * b + y2 - 0.0625).hi <= 0.0;
+}
+
+// Same steps and interior checks as mandelbrot_point; the escape test only
+// needs the high parts.
+float mandelbrot_point_dd(Coordinate cr, Coordinate ci, int iterations) {
+    bool checks = interior_checks();
+    if (checks && in_main_bulbs_dd(cr, ci)) return 1.0f;
+    Coordinate zr, zi, zr2, zi2, saved_r, saved_i;
+    for (int i = 0; i < iterations; ++i) {
+        zi = zr * 2.0 * zi + ci;
+        zr = zr2 - zi2 + cr;
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        if (zr2.hi + zi2.hi > 4.0) return static_cast<float>(i) / iterations;
+        if (checks) {
+            if (zr == saved_r && zi == saved_i) return 1.0f;
+            if ((i & (i + 1)) == 0) {
+                saved_r = zr;
+                saved_i = zi;
+            }
+        }
+    }
+    return 1.0f;
+}
+
+void mandelbrot_block_dd(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    for (int j = 0; j < grid.rows; ++j) {
+        Coordinate ci(grid.imag[j * grid.step_y], grid.imag_lo ? grid.imag_lo[j * grid.step_y] : 0.0);
+        for (int i = 0; i < grid.columns; ++i) {
+            Coordinate cr(grid.real[i * grid.step_x], grid.real_lo ? grid.real_lo[i * grid.step_x] : 0.0);
+            out[j * out_stride + i * grid.step_x] = mandelbrot_point_dd(cr, ci, iterations);
+        }
+    }
+}
+
+// The lane operations EscapeFormula uses, on one Coordinate
+struct DoubleDoubleOps {
+    static Coordinate set1(double value) { return Coordinate(value); }
+    static Coordinate add(const Coordinate& a, const Coordinate& b) { return a + b; }
+    static Coordinate sub(const Coordinate& a, const Coordinate& b) { return a - b; }
+    static Coordinate mul(const Coordinate& a, const Coordinate& b) { return a * b; }
+    static Coordinate abs(const Coordinate& a) { return a.hi < 0.0 ? -a : a; }
+};
+
+// The rest of the escape-time family, stepped like escape_orbit; the
+// Mandelbrot set keeps mandelbrot_point_dd unless it estimates distances.
+// The derivative only needs its leading digits, so it is a double pair
+// stepped from the high parts of z.
+template <class Formula, bool Distance = false>
+float escape_point_dd(const Coordinate& x, const Coordinate& y, int iterations, double pixel = 0.0, float* distance = nullptr) {
+    typedef scalar_kernels::ScalarOps<double> Ops;
+    bool checks = interior_checks();
+    if (Distance) *distance = 0.0f;
+    if (Formula::bulbs && checks && in_main_bulbs_dd(x, y)) return 1.0f;
+    Coordinate cr = Formula::julia ? Coordinate(JULIA_REAL) : x;
+    Coordinate ci = Formula::julia ? Coordinate(JULIA_IMAG) : y;
+    Coordinate zr, zi;
+    if (Formula::julia) {
+        zr = x;
+        zi = y;
+    }
+    Coordinate zr2 = zr * zr, zi2 = zi * zi, saved_r = zr, saved_i = zi;
+    double dr = Formula::julia ? 1.0 : 0.0, di = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        if (Distance) Formula::template derive<Ops>(dr, di, zr.hi, zi.hi);
+        Formula::template step<DoubleDoubleOps>(zr, zi, zr2, zi2, cr, ci);
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        if (zr2.hi + zi2.hi > 4.0) {
+            if (Distance) {
+                double estimate = scalar_kernels::escape_distance<Formula>(zr.hi, zi.hi, dr, di, cr.hi, ci.hi);
+                return scalar_kernels::distance_value(estimate, pixel, *distance);
+            }
+            return static_cast<float>(i) / iterations;
+        }
+        if (checks) {
+            if (zr == saved_r && zi == saved_i) return 1.0f;
+            if ((i & (i + 1)) == 0) {
+                saved_r = zr;
+                saved_i = zi;
+            }
+        }
+    }
+    return 1.0f;
+}
+
+template <class Formula, bool Distance = false>
+void escape_block_dd(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    for (int j = 0; j < grid.rows; ++j) {
+        Coordinate ci(grid.imag[j * grid.step_y], grid.imag_lo ? grid.imag_lo[j * grid.step_y] : 0.0);
+        for (int i = 0; i < grid.columns; ++i) {
+            Coordinate cr(grid.real[i * grid.step_x], grid.real_lo ? grid.real_lo[i * grid.step_x] : 0.0);
+            std::ptrdiff_t offset = j * out_stride + i * grid.step_x;
+            out[offset] = escape_point_dd<Formula, Distance>(cr, ci, iterations, grid.pixel, Distance ? &grid.distance[offset] : nullptr);
+        }
+    }
+}
+
+// The double-double block for type, or false if the type has none
+bool escape_time_block_dd(FractalType type, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    if (grid.distance) {
+        switch (type) {
+        case MANDELBROT: escape_block_dd<scalar_kernels::MandelbrotFormula, true>(grid, iterations, out, out_stride); return true;
+        case JULIA: escape_block_dd<scalar_kernels::JuliaFormula, true>(grid, iterations, out, out_stride); return true;
+        case MULTIBROT: escape_block_dd<scalar_kernels::MultibrotFormula, true>(grid, iterations, out, out_stride); return true;
+        default: break;
+        }
+    }
+    switch (type) {
+    case MANDELBROT: mandelbrot_block_dd(grid, iterations, out, out_stride); return true;
+    case JULIA: escape_block_dd<scalar_kernels::JuliaFormula>(grid, iterations, out, out_stride); return true;
+    case MULTIBROT: escape_block_dd<scalar_kernels::MultibrotFormula>(grid, iterations, out, out_stride); return true;
+    case BURNING_SHIP: escape_block_dd<scalar_kernels::BurningShipFormula>(grid, iterations, out, out_stride); return true;
+    case TRICORN: escape_block_dd<scalar_kernels::TricornFormula>(grid, iterations, out, out_stride); return true;
+    default: return false;
+    }
+}
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+void ReferencePoint::compute(const BigFixed& real, const BigFixed& imag, int iterations) {
+    orbit_real.assign(1, 0.0);
+    orbit_imag.assign(1, 0.0);
+    orbit_glitch.assign(1, 0.0);
+
+    BigFixed zr(0.0, real.fraction_bits()), zi(0.0, imag.fraction_bits());
+    for (int i = 0; i < iterations; ++i) {
+        BigFixed zri = zr * zi;
+        zr = zr * zr - zi * zi + real;
+        zi = zri + zri + imag;
+        double r = static_cast<double>(zr), m = static_cast<double>(zi);
+        double magnitude = r * r + m * m;
+        orbit_real.push_back(r);
+        orbit_imag.push_back(m);
+        orbit_glitch.push_back(PERTURBATION_TOLERANCE * magnitude);
+        if (magnitude > 4.0) break;
+    }
+}
+
+ReferenceOrbit ReferencePoint::orbit() const {
+    ReferenceOrbit orbit = { orbit_real.data(), orbit_imag.data(), orbit_glitch.data(), static_cast<int>(orbit_real.size()) };
+    return orbit;
+}
+
+namespace {
+// Closed interval [lo, hi]; every operation moves its bounds outwards by
+// at least an ulp, which covers the rounding of the operation itself.
+struct Interval {
+    double lo, hi;
+};
+
+Interval widen(double lo, double hi) {
+    const double ulps = 0x1p-51, tiny = std::numeric_limits<double>::min();
+    Interval r = { lo - (std::fabs(lo) * ulps + tiny), hi + (std::fabs(hi) * ulps + tiny) };
+    return r;
+}
+
+Interval operator+(Interval a, Interval b) { return widen(a.lo + b.lo, a.hi + b.hi); }
+Interval operator-(Interval a, Interval b) { return widen(a.lo - b.hi, a.hi - b.lo); }
+
+Interval operator*(Interval a, Interval b) {
+    double p[] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+    return widen(std::min({ p[0], p[1], p[2], p[3] }), std::max({ p[0], p[1], p[2], p[3] }));
+}
+
+Interval square(Interval a) {
+    if (a.lo >= 0.0) return widen(a.lo * a.lo, a.hi * a.hi);
+    if (a.hi <= 0.0) return widen(a.hi * a.hi, a.lo * a.lo);
+    return widen(0.0, std::max(a.lo * a.lo, a.hi * a.hi));
+}
+
+bool contains(Interval outer, Interval inner) { return outer.lo <= inner.lo && inner.hi <= outer.hi; }
+}
+
+// Squaring and adding are monotone under inclusion, so once the box of z
+// lies inside an earlier one it stays inside the boxes that followed that
+// one, all of which are known to be bounded. Earlier boxes are saved on
+// the iterations 2^k - 1, as in the point kernels' cycle test.
+float mandelbrot_box(double real_lo, double real_hi, double imag_lo, double imag_hi, int iterations, double margin) {
+    const Interval cr = { real_lo, real_hi }, ci = { imag_lo, imag_hi };
+    const double escape = 4.0 * (1.0 + margin), bounded = 4.0 * (1.0 - margin);
+
+    // The bulb tests of in_main_bulbs, true for the box if their upper
+    // bounds hold
+    Interval x = cr - Interval{ 0.25, 0.25 }, y2 = square(ci);
+    Interval q = square(x) + y2;
+    if ((q * (q + x)).hi <= (Interval{ 0.25, 0.25 } * y2).lo) return 1.0f;
+    Interval b = cr + Interval{ 1.0, 1.0 };
+    if ((square(b) + y2).hi <= 0.0625) return 1.0f;
+
+    Interval zr = { 0.0, 0.0 }, zi = { 0.0, 0.0 };
+    Interval saved_r = zr, saved_i = zi;
+    for (int i = 0; i < iterations; ++i) {
+        Interval zr2 = square(zr), zi2 = square(zi);
+        Interval zri = zr * zi;
+        zi = zri + zri + ci;
+        zr = zr2 - zi2 + cr;
+        Interval magnitude = square(zr) + square(zi);
+        if (magnitude.lo > escape) return static_cast<float>(i) / iterations;
+        if (magnitude.hi > bounded) return MANDELBROT_BOX_MIXED;
+        if (contains(saved_r, zr) && contains(saved_i, zi)) return 1.0f;
+        if ((i & (i + 1)) == 0) {
+            saved_r = zr;
+            saved_i = zi;
+        }
+    }
+    return 1.0f;
+}
+
+float mandelbrot(double real, double imag, int max_iter) {
+    return scalar_kernels::mandelbrot_point(real, imag, max_iter);
+}
+
+float mandelbrot_distance(double real, double imag, int max_iter) {
+    return scalar_kernels::mandelbrot_point_distance(real, imag, max_iter);
+}
+
+float sierpinski_carpet(double x, double y, int iterations) {
+    return scalar_kernels::sierpinski_carpet(x, y, iterations);
+}
+
+float cantor_dust(double x, double y, int iterations) {
+    return scalar_kernels::cantor_dust(x, y, iterations);
+}
+
+float peano_curve(double x, double y, int iterations) {
+    return scalar_kernels::peano_curve(x, y, iterations);
+}
 
- 
\ No newline at end of file
+float hilbert_curve(double x, double y, int iterations) {
+    return scalar_kernels::hilbert_curve(x, y, iterations);
+}
+
+float sierpinski_triangle(double x, double y, int iterations) {
+    return scalar_kernels::sierpinski_triangle(x, y, iterations);
+}
+
+float box_fractal(double x, double y, int iterations) {
+    return scalar_kernels::box_fractal(x, y, iterations);
+}
+
+float cantor_ternary_grid(double x, double y, int iterations) {
+    return scalar_kernels::cantor_ternary_grid(x, y, iterations);
+}
+
+float sierpinski_hexagon(double x, double y, int iterations) {
+    return scalar_kernels::sierpinski_hexagon(x, y, iterations);
+}
+
+float cantor_maze(double x, double y, int iterations) {
+    return scalar_kernels::cantor_maze(x, y, iterations);
+}
+
+float peano_meander_curve(double x, double y, int iterations) {
+    return scalar_kernels::peano_meander_curve(x, y, iterations);
+}
+
+float vicsek_fractal(double x, double y, int iterations) {
+    return scalar_kernels::vicsek_fractal(x, y, iterations);
+}
+
+float hexaflake(double x, double y, int iterations) {
+    return scalar_kernels::hexaflake(x, y, iterations);
+}
+
+float cantor_square(double x, double y, int iterations) {
+    return scalar_kernels::cantor_square(x, y, iterations);
+}
+
+float hilbert_variant(double x, double y, int iterations) {
+    return scalar_kernels::hilbert_variant(x, y, iterations);
+}
+
+float sierpinski_pentagon(double x, double y, int iterations) {
+    return scalar_kernels::sierpinski_pentagon(x, y, iterations);
+}
+
+float cantor_cloud(double x, double y, int iterations) {
+    return scalar_kernels::cantor_cloud(x, y, iterations);
+}
+
+float moore_curve(double x, double y, int iterations) {
+    return scalar_kernels::moore_curve(x, y, iterations);
+}
+
+float sierpinski_square(double x, double y, int iterations) {
+    return scalar_kernels::sierpinski_square(x, y, iterations);
+}
+
+// Entry points of each variant, indexed by KernelIsa
+struct KernelTable {
+    void (*span)(FractalType, const double*, double, int, int, int, float*);
+    void (*block)(FractalType, Precision, const SampleGrid&, int, float*, std::ptrdiff_t);
+};
+
+static const KernelTable kernel_tables[] = {
+    { scalar_kernels::span_kernel, scalar_kernels::block_kernel },
+#if CPU_X86
+    { evaluate_span_sse2, evaluate_block_sse2 },
+    { evaluate_span_avx2, evaluate_block_avx2 },
+    { evaluate_span_avx512, evaluate_block_avx512 },
+#endif
+};
+
+// Best variant up to the one the CPU supports that was compiled for its
+// instruction set
+static KernelIsa built_kernel_isa() {
+    KernelIsa isa = detect_kernel_isa();
+#if CPU_X86
+    if (isa == ISA_AVX512 && !avx512_kernels_native()) isa = ISA_AVX2;
+    if (isa == ISA_AVX2 && !avx2_kernels_native()) isa = ISA_SSE2;
+#endif
+    return isa;
+}
+
+static std::atomic<KernelIsa> active_isa(built_kernel_isa());
+static std::atomic<const KernelTable*> active_kernels(&kernel_tables[active_isa]);
+
+void select_kernel_isa(KernelIsa isa) {
+    KernelIsa best = built_kernel_isa();
+    if (isa > best) isa = best;
+    active_isa = isa;
+    active_kernels = &kernel_tables[isa];
+}
+
+KernelIsa kernel_isa() {
+    return active_isa;
+}
+
+static std::atomic<bool> interior_checks_enabled(true);
+
+void set_interior_checks(bool enabled) {
+    interior_checks_enabled = enabled;
+}
+
+bool interior_checks() {
+    return interior_checks_enabled.load(std::memory_order_relaxed);
+}
+
+void evaluate_span(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out) {
+    active_kernels.load(std::memory_order_relaxed)->span(type, real, imag, iterations, count, stride, out);
+}
+
+void evaluate_block(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    if (precision == PRECISION_DOUBLE_DOUBLE && escape_time_block_dd(type, grid, iterations, out, out_stride)) return;
+    active_kernels.load(std::memory_order_relaxed)->block(type, precision, grid, iterations, out, out_stride);
+}
@@ -4,9 +4,21 @@
 #include <complex>
 #include <vector>
 #include <cmath>
+#include <cstddef>
 
-// Mandelbrot set
-float mandelbrot(double real, double imag);
+#include "fractal.h"
+#include "kernels.h"
+
+// Mandelbrot set: i / max_iter for the iteration z escapes on, 1 if it
+// stays bounded (the shader's normalisation)
+float mandelbrot(double real, double imag, int max_iter = 50);
+
+// Exterior distance estimate of c from the Mandelbrot set, from the
+// derivative dz/dc carried along with the orbit: |z| log|z| / 2 |dz/dc|
+// once |z| is large, which is about the lower bound the Koebe quarter
+// theorem gives (the true distance is at most 4 times it). 0 if the orbit
+// stays bounded for max_iter iterations.
+float mandelbrot_distance(double real, double imag, int max_iter = 50);
 
 // Fractal generators that return point sets
 std::vector<std::complex<double>> generate_koch_curve(int iterations);
@@ -66,6 +78,51 @@ float sierpinski_pentagon(double x, double y, int iterations);
 float cantor_cloud(double x, double y, int iterations);
 float sierpinski_square(double x, double y, int iterations);
 
+// Span evaluation for the pixel fractals: evaluates type at
+// (real[i * stride], imag) for i = 0 .. count - 1 into out[i * stride],
+// clamped to [0, 1]. The type is dispatched once per span, and each kernel
+// is a plain loop over its point test with the test inlined.
+void evaluate_span(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out);
+
+// Owns the orbit of one reference point, iterated in BigFixed at the
+// precision of the point.
+class ReferencePoint {
+public:
+    void compute(const BigFixed& real, const BigFixed& imag, int iterations);
+    ReferenceOrbit orbit() const;
+
+private:
+    std::vector<double> orbit_real, orbit_imag, orbit_glitch;
+};
+
+// Block evaluation of grid into out[j * out_stride + i * step_x]. The
+// escape-time kernels feed their vector lanes from the whole block, so a
+// lane that finishes early picks up the next pixel instead of idling, and
+// run in the given precision (resolved, not PRECISION_AUTO): float lanes
+// are twice as wide as double, double-double is scalar, and perturbation
+// needs grid.reference and writes a negative value, minus the fraction of
+// the iterations done, for the samples its reference cannot resolve. The
+// pixel fractals ignore precision, and so do user formulas, which run in
+// double.
+void evaluate_block(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+
+#define MANDELBROT_BOX_MIXED -1.0f // mandelbrot_box could not give the whole box one value
+
+// Iterates every c of the box [real_lo, real_hi] x [imag_lo, imag_hi] at
+// once, in interval arithmetic rounded outwards. Returns the value they
+// all have: i / iterations if every orbit provably escapes on iteration i,
+// 1 if none ever escapes (the box lies in the main bulbs, the box of z
+// lands inside an earlier one, or it stays bounded to the cap). Otherwise MANDELBROT_BOX_MIXED. |z|^2 must
+// clear 4 by the relative margin either way, to allow for the rounding of
+// the point kernels the answer stands in for.
+float mandelbrot_box(double real_lo, double real_hi, double imag_lo, double imag_hi, int iterations, double margin);
+
+// Instruction-set variant the span and block kernels run; defaults to the
+// best one the CPU supports and the build compiled for. Requests above
+// that are lowered to it. Select before rendering starts.
+void select_kernel_isa(KernelIsa isa);
+KernelIsa kernel_isa();
+
 float koch_quadratic(double x, double y, int iterations);
 float gosper_island(double x, double y, int iterations);
 float snowflake_sweep(double x, double y, int iterations);
@@ -0,0 +1,139 @@
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "kernels.h"
+
+// AVX2 build of the pixel fractal kernels. MSVC gets /arch:AVX2 from the
+// project; GCC and Clang target it here. Contraction into FMA is off so
+// results match the other variants bit for bit.
+#if CPU_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+#undef M_PI
+#define M_PI 3.14159265358979
+
+namespace avx2_kernels {
+#include "pixel_kernels.inl"
+
+#if defined(_MSC_VER) && !defined(__AVX2__)
+// Built without /arch:AVX2
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, double, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, float>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_grid<Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<ScalarOps<double> >(grid, iterations, out, out_stride);
+}
+#else
+// Lane descriptions for escape_lanes and formula_lanes: the vector and
+// scalar types, the lane count, arithmetic with div() and abs(),
+// comparisons returning one bit per lane, clear(), which zeroes the lanes
+// whose bits are set, and select(), which takes b in those lanes and a in
+// the rest.
+struct DoubleLanes {
+    typedef __m256d Vec;
+    typedef double Scalar;
+    static const int count = 4;
+    static Vec set1(Scalar value) { return _mm256_set1_pd(value); }
+    static Vec load(const Scalar* p) { return _mm256_loadu_pd(p); }
+    static void store(Scalar* p, Vec v) { _mm256_storeu_pd(p, v); }
+    static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+    static Vec abs(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static unsigned greater(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ))); }
+    static unsigned greater_equal(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ))); }
+    static unsigned equal(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ))); }
+    static Vec mask(unsigned bits) {
+        const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), lane_bits), lane_bits));
+    }
+    static Vec clear(Vec v, unsigned bits) { return _mm256_andnot_pd(mask(bits), v); }
+    static Vec select(Vec a, Vec b, unsigned bits) { return _mm256_blendv_pd(a, b, mask(bits)); }
+};
+
+struct FloatLanes {
+    typedef __m256 Vec;
+    typedef float Scalar;
+    static const int count = 8;
+    static Vec set1(Scalar value) { return _mm256_set1_ps(value); }
+    static Vec load(const Scalar* p) { return _mm256_loadu_ps(p); }
+    static void store(Scalar* p, Vec v) { _mm256_storeu_ps(p, v); }
+    static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+    static Vec abs(Vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static unsigned greater(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))); }
+    static unsigned greater_equal(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))); }
+    static unsigned equal(Vec a, Vec b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))); }
+    static Vec mask(unsigned bits) {
+        const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), lane_bits), lane_bits));
+    }
+    static Vec clear(Vec v, unsigned bits) { return _mm256_andnot_ps(mask(bits), v); }
+    static Vec select(Vec a, Vec b, unsigned bits) { return _mm256_blendv_ps(a, b, mask(bits)); }
+};
+
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_lanes<Formula, DoubleLanes, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_lanes<Formula, FloatLanes>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_lanes<DoubleLanes, Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<DoubleLanes>(grid, iterations, out, out_stride);
+}
+#endif
+}
+
+void evaluate_span_avx2(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out) {
+    avx2_kernels::span_kernel(type, real, imag, iterations, count, stride, out);
+}
+
+void evaluate_block_avx2(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    avx2_kernels::block_kernel(type, precision, grid, iterations, out, out_stride);
+}
+
+bool avx2_kernels_native() {
+#if defined(_MSC_VER) && !defined(__AVX2__)
+    return false;
+#else
+    return true;
+#endif
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
@@ -0,0 +1,128 @@
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "kernels.h"
+
+// AVX-512 build of the pixel fractal kernels. MSVC gets /arch:AVX512 from
+// the project; GCC and Clang target it here. Contraction into FMA is off so
+// results match the other variants bit for bit.
+#if CPU_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+#undef M_PI
+#define M_PI 3.14159265358979
+
+namespace avx512_kernels {
+#include "pixel_kernels.inl"
+
+#if defined(_MSC_VER) && !defined(__AVX512F__)
+// Built without /arch:AVX512 (older toolsets have no AVX-512 support)
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, double, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, float>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_grid<Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<ScalarOps<double> >(grid, iterations, out, out_stride);
+}
+#else
+// Lane descriptions for escape_lanes (see math_avx2.cpp); comparisons
+// come straight out as mask registers.
+struct DoubleLanes {
+    typedef __m512d Vec;
+    typedef double Scalar;
+    static const int count = 8;
+    static Vec set1(Scalar value) { return _mm512_set1_pd(value); }
+    static Vec load(const Scalar* p) { return _mm512_loadu_pd(p); }
+    static void store(Scalar* p, Vec v) { _mm512_storeu_pd(p, v); }
+    static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm512_div_pd(a, b); }
+    static Vec abs(Vec a) { return _mm512_abs_pd(a); }
+    static unsigned greater(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static unsigned greater_equal(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static unsigned equal(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static Vec clear(Vec v, unsigned bits) { return _mm512_mask_mov_pd(v, static_cast<__mmask8>(bits), _mm512_setzero_pd()); }
+    static Vec select(Vec a, Vec b, unsigned bits) { return _mm512_mask_mov_pd(a, static_cast<__mmask8>(bits), b); }
+};
+
+struct FloatLanes {
+    typedef __m512 Vec;
+    typedef float Scalar;
+    static const int count = 16;
+    static Vec set1(Scalar value) { return _mm512_set1_ps(value); }
+    static Vec load(const Scalar* p) { return _mm512_loadu_ps(p); }
+    static void store(Scalar* p, Vec v) { _mm512_storeu_ps(p, v); }
+    static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+    static Vec abs(Vec a) { return _mm512_abs_ps(a); }
+    static unsigned greater(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static unsigned greater_equal(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static unsigned equal(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static Vec clear(Vec v, unsigned bits) { return _mm512_mask_mov_ps(v, static_cast<__mmask16>(bits), _mm512_setzero_ps()); }
+    static Vec select(Vec a, Vec b, unsigned bits) { return _mm512_mask_mov_ps(a, static_cast<__mmask16>(bits), b); }
+};
+
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_lanes<Formula, DoubleLanes, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_lanes<Formula, FloatLanes>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_lanes<DoubleLanes, Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<DoubleLanes>(grid, iterations, out, out_stride);
+}
+#endif
+}
+
+void evaluate_span_avx512(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out) {
+    avx512_kernels::span_kernel(type, real, imag, iterations, count, stride, out);
+}
+
+void evaluate_block_avx512(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    avx512_kernels::block_kernel(type, precision, grid, iterations, out, out_stride);
+}
+
+bool avx512_kernels_native() {
+#if defined(_MSC_VER) && !defined(__AVX512F__)
+    return false;
+#else
+    return true;
+#endif
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
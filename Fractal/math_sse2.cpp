@@ -0,0 +1,53 @@
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "kernels.h"
+
+// SSE2 build of the pixel fractal kernels. MSVC gets /arch:SSE2 from the
+// project on Win32 (x64 has it as baseline); GCC and Clang target it here.
+#if CPU_X86
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse2")
+#endif
+#undef M_PI
+#define M_PI 3.14159265358979
+
+namespace sse2_kernels {
+#include "pixel_kernels.inl"
+
+// Two doubles (or four floats) per register would not pay for the lane
+// bookkeeping; the scalar loops already run on SSE2 arithmetic
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, double, Distance>(grid, iterations, out, out_stride);
+}
+
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    escape_grid<Formula, float>(grid, iterations, out, out_stride);
+}
+
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    perturbed_grid<Distance>(grid, iterations, out, out_stride);
+}
+
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    formula_lanes<ScalarOps<double> >(grid, iterations, out, out_stride);
+}
+}
+
+void evaluate_span_sse2(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out) {
+    sse2_kernels::span_kernel(type, real, imag, iterations, count, stride, out);
+}
+
+void evaluate_block_sse2(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    sse2_kernels::block_kernel(type, precision, grid, iterations, out, out_stride);
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
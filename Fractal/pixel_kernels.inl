@@ -0,0 +1,1203 @@
+// Point tests of the pixel fractals, the escape-time family (Mandelbrot
+// and its relatives) and the span and block loops over them.
+//
+// Not a normal header: it has no includes or guards of its own and is
+// included inside a namespace once per instruction-set variant (math.cpp,
+// math_sse2.cpp, math_avx2.cpp, math_avx512.cpp), so each variant gets its
+// own copy compiled for its target. Keep std:: templates and any other
+// inline library code (numeric_limits, the float overloads of <cmath>) out
+// of it; an inline function instantiated under different targets could be
+// merged by the linker into the copy the CPU cannot run. The variants see
+// only kernels.h for the same reason.
+
+float sierpinski_carpet(double x, double y, int iterations) {
+
+    assert(iterations >= 0 && iterations <= 100000); // Sanity check 
+
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if (xi == 1 && yi == 1) return 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return 1.0f;
+}
+
+float cantor_dust(double x, double y, int iterations) {
+
+    assert(iterations >= 0 && iterations <= 100000); // Sanity check 
+
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if (xi == 1 || yi == 1) value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float peano_curve(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    int n = 1 << iterations;
+    int index = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int rx = static_cast<int>(x * 3);
+        int ry = static_cast<int>(y * 3);
+        index = index * 9 + (ry * 3 + rx);
+        x = (x * 3) - rx;
+        y = (y * 3) - ry;
+    }
+    return index / static_cast<float>(n * n);
+}
+
+float hilbert_curve(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    int n = 1 << iterations;
+    int index = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int rx = static_cast<int>(x * 2);
+        int ry = static_cast<int>(y * 2);
+        index = index * 4 + ((rx ^ ry) * 2 + rx);
+        x = (x * 2) - rx;
+        y = (y * 2) - ry;
+    }
+    return index / static_cast<float>(n * n);
+}
+
+float sierpinski_triangle(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1 || y > 1 - x) return 0.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 2);
+        int yi = static_cast<int>(y * 2);
+        if (xi + yi >= 2) return 0.0f;
+        x = (x * 2) - xi;
+        y = (y * 2) - yi;
+    }
+    return 1.0f;
+}
+
+float box_fractal(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if ((xi == 0 || xi == 2) && (yi == 0 || yi == 2)) value *= 1.0f;
+        else value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float cantor_ternary_grid(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if (xi == 1 && yi == 1) value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float sierpinski_hexagon(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
+    double cx = 0.5, cy = std::sqrt(3.0) / 4.0;
+    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+    if (r > std::sqrt(3.0) / 2.0) return 0.0f;
+    for (int i = 0; i < iterations; ++i) {
+        double scale = 3.0;
+        int closest = 0;
+        double min_dist = DBL_MAX;
+        for (int j = 0; j < 6; ++j) {
+            double angle = j * M_PI / 3.0;
+            double hx = cx + std::cos(angle) * std::sqrt(3.0) / (2.0 * scale);
+            double hy = cy + std::sin(angle) * std::sqrt(3.0) / (2.0 * scale);
+            double dist = std::sqrt((x - hx) * (x - hx) + (y - hy) * (y - hy));
+            if (dist < min_dist) {
+                min_dist = dist;
+                closest = j;
+            }
+        }
+        if (closest == 0 && min_dist < std::sqrt(3.0) / (6.0 * scale)) return 0.0f;
+        double angle = closest * M_PI / 3.0;
+        x = (x - cx) * scale + cx - std::cos(angle) * std::sqrt(3.0) / 2.0;
+        y = (y - cy) * scale + cy - std::sin(angle) * std::sqrt(3.0) / 2.0;
+    }
+    return 1.0f;
+}
+
+float cantor_maze(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if ((xi == 1 || yi == 1) && !(xi == 1 && yi == 1)) value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float peano_meander_curve(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    int n = 1 << iterations;
+    int index = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int rx = static_cast<int>(x * 3);
+        int ry = static_cast<int>(y * 3);
+        int quadrant = (ry * 3 + rx);
+        if (i % 2 == 1) quadrant = (9 - quadrant) % 9;
+        index = index * 9 + quadrant;
+        x = (x * 3) - rx;
+        y = (y * 3) - ry;
+    }
+    return index / static_cast<float>(n * n);
+}
+
+float vicsek_fractal(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if ((xi == 1 && yi != 1) || (yi == 1 && xi != 1) || (xi == 1 && yi == 1)) value *= 1.0f;
+        else value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float hexaflake(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
+    double cx = 0.5, cy = std::sqrt(3.0) / 4.0;
+    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+    if (r > std::sqrt(3.0) / 2.0) return 0.0f;
+    for (int i = 0; i < iterations; ++i) {
+        double scale = 3.0;
+        int closest = 0;
+        double min_dist = DBL_MAX;
+        for (int j = 0; j < 7; ++j) {
+            double angle = (j == 0) ? 0 : (j - 1) * M_PI / 3.0;
+            double hx = cx + (j == 0 ? 0 : std::cos(angle) * std::sqrt(3.0) / (3.0 * scale));
+            double hy = cy + (j == 0 ? 0 : std::sin(angle) * std::sqrt(3.0) / (3.0 * scale));
+            double dist = std::sqrt((x - hx) * (x - hx) + (y - hy) * (y - hy));
+            if (dist < min_dist) {
+                min_dist = dist;
+                closest = j;
+            }
+        }
+        if (closest == 0) return 1.0f;
+        double angle = (closest - 1) * M_PI / 3.0;
+        x = (x - cx) * scale + cx - std::cos(angle) * std::sqrt(3.0) / 3.0;
+        y = (y - cy) * scale + cy - std::sin(angle) * std::sqrt(3.0) / 3.0;
+    }
+    return 1.0f;
+}
+
+float cantor_square(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if (!(xi == 0 || xi == 2) || !(yi == 0 || yi == 2)) value *= 0.0f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float hilbert_variant(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    int n = 1 << iterations;
+    int index = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int rx = static_cast<int>(x * 2);
+        int ry = static_cast<int>(y * 2);
+        int quadrant = (rx * 2 + ry);
+        if (i % 2 == 1) quadrant = (3 - quadrant) % 4;
+        index = index * 4 + quadrant;
+        x = (x * 2) - rx;
+        y = (y * 2) - ry;
+    }
+    return index / static_cast<float>(n * n);
+}
+
+float sierpinski_pentagon(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < -0.5 || y > 1.5) return 0.0f;
+    double cx = 0.5, cy = 0.5 * std::tan(M_PI / 5.0);
+    double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+    if (r > std::sin(2.0 * M_PI / 5.0) / (2.0 * std::cos(M_PI / 5.0))) return 0.0f;
+    for (int i = 0; i < iterations; ++i) {
+        double scale = 2.0 + std::cos(2.0 * M_PI / 5.0);
+        int closest = 0;
+        double min_dist = DBL_MAX;
+        for (int j = 0; j < 6; ++j) {
+            double angle = j * 2.0 * M_PI / 5.0;
+            double px = cx + (j == 0 ? 0 : std::cos(angle) * std::sin(2.0 * M_PI / 5.0) / scale);
+            double py = cy + (j == 0 ? 0 : std::sin(angle) * std::sin(2.0 * M_PI / 5.0) / scale);
+            double dist = std::sqrt((x - px) * (x - px) + (y - py) * (y - py));
+            if (dist < min_dist) {
+                min_dist = dist;
+                closest = j;
+            }
+        }
+        if (closest == 0) return 0.0f;
+        double angle = (closest - 1) * 2.0 * M_PI / 5.0;
+        x = (x - cx) * scale + cx - std::cos(angle) * std::sin(2.0 * M_PI / 5.0) / scale;
+        y = (y - cy) * scale + cy - std::sin(angle) * std::sin(2.0 * M_PI / 5.0) / scale;
+    }
+    return 1.0f;
+}
+
+float cantor_cloud(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 3);
+        int yi = static_cast<int>(y * 3);
+        if (xi == 1 && yi == 1) value *= 0.0f;
+        else if ((xi == 1 || yi == 1) && (rand() % 2)) value *= 0.5f;
+        x = (x * 3) - xi;
+        y = (y * 3) - yi;
+    }
+    return value;
+}
+
+float moore_curve(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    int n = 1 << iterations;
+    int index = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int rx = static_cast<int>(x * 2);
+        int ry = static_cast<int>(y * 2);
+        int quadrant = (rx ^ ry) * 2 + rx;
+        if (i % 2 == 0) quadrant = (quadrant + 1) % 4;
+        index = index * 4 + quadrant;
+        x = (x * 2) - rx;
+        y = (y * 2) - ry;
+    }
+    return index / static_cast<float>(n * n);
+}
+
+float sierpinski_square(double x, double y, int iterations) {
+    x = (x - 0.0) / (1.0 - 0.0);
+    y = (y - 0.0) / (1.0 - 0.0);
+    if (x < 0 || x > 1 || y < 0 || y > 1) return 0.0f;
+    float value = 1.0f;
+    for (int i = 0; i < iterations; ++i) {
+        int xi = static_cast<int>(x * 5);
+        int yi = static_cast<int>(y * 5);
+        if (xi == 2 && yi == 2) return 0.0f;
+        x = (x * 5) - xi;
+        y = (y * 5) - yi;
+    }
+    return value;
+}
+
+// The main cardioid and the period-2 bulb, which hold most of the interior
+// of a wide view. Points in them never escape, so they can skip the loop.
+static bool in_main_bulbs(double real, double imag) {
+    double x = real - 0.25, y2 = imag * imag;
+    double q = x * x + y2;
+    if (q * (q + x) <= 0.25 * y2) return true;
+    double b = real + 1.0;
+    return b * b + y2 <= 0.0625;
+}
+
+enum EscapeFold { FOLD_NONE, FOLD_ABS, FOLD_CONJUGATE };
+
+// z^Power + c with z folded first, written once for scalars (ScalarOps)
+// and vector lanes alike. zr2 and zi2 are the squares the escape test left.
+template <int Power, EscapeFold Fold>
+struct EscapePower {
+    template <class Ops, class Vec>
+    static void step(Vec& zr, Vec& zi, Vec, Vec, Vec cr, Vec ci) {
+        Vec fr = zr, fi = zi;
+        if (Fold == FOLD_ABS) {
+            fr = Ops::abs(fr);
+            fi = Ops::abs(fi);
+        }
+        if (Fold == FOLD_CONJUGATE) fi = Ops::sub(Ops::set1(0), fi);
+        Vec wr = fr, wi = fi;
+        for (int k = 1; k < Power; ++k) {
+            Vec next_wr = Ops::sub(Ops::mul(wr, fr), Ops::mul(wi, fi));
+            wi = Ops::add(Ops::mul(wr, fi), Ops::mul(wi, fr));
+            wr = next_wr;
+        }
+        zr = Ops::add(wr, cr);
+        zi = Ops::add(wi, ci);
+    }
+};
+
+// Squares reuse zr2 and zi2, so the plain case is the Mandelbrot step as
+// it always was; folding only touches the sign of 2 zr zi.
+template <EscapeFold Fold>
+struct EscapePower<2, Fold> {
+    template <class Ops, class Vec>
+    static void step(Vec& zr, Vec& zi, Vec zr2, Vec zi2, Vec cr, Vec ci) {
+        Vec product = Ops::mul(Ops::mul(Ops::set1(2), zr), zi);
+        if (Fold == FOLD_ABS) product = Ops::abs(product);
+        zi = Fold == FOLD_CONJUGATE ? Ops::sub(ci, product) : Ops::add(product, ci);
+        zr = Ops::add(Ops::sub(zr2, zi2), cr);
+    }
+};
+
+// One member of the escape-time family, z -> fold(z)^Power + c, fixed at
+// compile time so each gets its own loop with nothing decided per step.
+// FOLD_ABS takes |Re z| + i |Im z| (Burning Ship), FOLD_CONJUGATE the
+// conjugate (Tricorn). The Mandelbrot form starts from z = 0 with c the
+// sample; the Julia form starts from z = the sample with c = JULIA_REAL +
+// i JULIA_IMAG. The main bulbs are only those of the Mandelbrot set.
+// Distance estimation needs z -> z^Power + c to be analytic, so not folded.
+template <int Power, EscapeFold Fold, bool Julia>
+struct EscapeFormula {
+    static const bool julia = Julia;
+    static const bool bulbs = Power == 2 && Fold == FOLD_NONE && !Julia;
+    static const bool distance = Fold == FOLD_NONE;
+
+    template <class Ops, class Vec>
+    static void step(Vec& zr, Vec& zi, Vec zr2, Vec zi2, Vec cr, Vec ci) {
+        EscapePower<Power, Fold>::template step<Ops>(zr, zi, zr2, zi2, cr, ci);
+    }
+
+    // The derivative d of z by the sample carried over the step from z:
+    // Power z^(Power - 1) d, plus 1 when the sample is c (for Julia it is
+    // the start value, and d starts at 1 instead of 0).
+    template <class Ops, class Vec>
+    static void derive(Vec& dr, Vec& di, Vec zr, Vec zi) {
+        Vec wr = Ops::set1(Power), wi = Ops::set1(0);
+        for (int k = 1; k < Power; ++k) {
+            Vec next_wr = Ops::sub(Ops::mul(wr, zr), Ops::mul(wi, zi));
+            wi = Ops::add(Ops::mul(wr, zi), Ops::mul(wi, zr));
+            wr = next_wr;
+        }
+        Vec next_dr = Ops::sub(Ops::mul(wr, dr), Ops::mul(wi, di));
+        di = Ops::add(Ops::mul(wr, di), Ops::mul(wi, dr));
+        dr = Julia ? next_dr : Ops::add(next_dr, Ops::set1(1));
+    }
+};
+
+typedef EscapeFormula<2, FOLD_NONE, false> MandelbrotFormula;
+typedef EscapeFormula<2, FOLD_NONE, true> JuliaFormula;
+typedef EscapeFormula<3, FOLD_NONE, false> MultibrotFormula;
+typedef EscapeFormula<2, FOLD_ABS, false> BurningShipFormula;
+typedef EscapeFormula<2, FOLD_CONJUGATE, false> TricornFormula;
+
+// The lane operations EscapeFormula and run_formula use, on one Real
+template <class Real>
+struct ScalarOps {
+    typedef Real Vec;
+    typedef Real Scalar;
+    static const int count = 1;
+    static Real set1(Real value) { return value; }
+    static Real load(const Real* p) { return *p; }
+    static void store(Real* p, Real v) { *p = v; }
+    static Real add(Real a, Real b) { return a + b; }
+    static Real sub(Real a, Real b) { return a - b; }
+    static Real mul(Real a, Real b) { return a * b; }
+    static Real div(Real a, Real b) { return a / b; }
+    static Real abs(Real a) { return a < 0 ? -a : a; } // std::fabs(float) is an inline overload
+    static unsigned greater(Real a, Real b) { return a > b; }
+    static unsigned equal(Real a, Real b) { return a == b; }
+};
+
+// Exterior distance estimate of a sample whose orbit under Formula has
+// just escaped to z, with derivative d (see EscapeFormula::derive). The
+// orbit is carried on in double until |z|^2 passes DISTANCE_ESCAPE, a few
+// steps, where |z| log|z| / 2 |d| is close to the lower bound the Koebe
+// quarter theorem puts on the distance to the set.
+template <class Formula>
+static double escape_distance(double zr, double zi, double dr, double di, double cr, double ci) {
+    typedef ScalarOps<double> Ops;
+    double zr2 = zr * zr, zi2 = zi * zi;
+    for (int i = 0; i < DISTANCE_MAX_STEPS && zr2 + zi2 <= DISTANCE_ESCAPE; ++i) {
+        Formula::template derive<Ops>(dr, di, zr, zi);
+        Formula::template step<Ops>(zr, zi, zr2, zi2, cr, ci);
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+    }
+    double magnitude = std::sqrt(zr2 + zi2);
+    // |d| without std::hypot, which MSVC defines inline; scaled, as d can
+    // be too large to square
+    double ar = dr < 0 ? -dr : dr, ai = di < 0 ? -di : di;
+    double scale = ar > ai ? ar : ai;
+    double length = scale > 0 ? scale * std::sqrt((ar / scale) * (ar / scale) + (ai / scale) * (ai / scale)) : 0.0;
+    return magnitude * std::log(magnitude) / (2.0 * length);
+}
+
+// Output of a sample for distance estimation: the estimate in pixels goes
+// to distance, and the value fades from 1 on the boundary to 0 at
+// DISTANCE_FALLOFF pixels from it. Samples that stay bounded have 0.
+static float distance_value(double estimate, double pixel, float& distance) {
+    double pixels = estimate / pixel;
+    distance = static_cast<float>(pixels);
+    return pixels < DISTANCE_FALLOFF ? static_cast<float>(1.0 - pixels / DISTANCE_FALLOFF) : 0.0f;
+}
+
+// Escape-time iteration of Formula, normalised like the shader: i /
+// iterations for the iteration z escapes on, 1 if it stays bounded.
+// Compares the squared magnitude, and the squares feed the next step, so
+// no sqrt. Runs in Real from wherever state left the orbit, and leaves
+// state where it stops; a sample that has escaped or is known to be
+// interior is only recoloured, one that got past the cap already is 1.
+//
+// With interior_checks() on, Mandelbrot points in the main bulbs return 1
+// straight away, and so do orbits that come back exactly to an earlier z
+// (Brent: z is saved on the iterations 2^k - 1, so the gap outgrows any
+// period). A repeated z repeats forever, so the result is the same as
+// running on.
+//
+// With Distance the derivative is carried along, state must be fresh, and
+// the result is distance_value's for pixels of size pixel.
+template <class Formula, class Real, bool Distance = false>
+static float escape_orbit(Real x, Real y, int iterations, EscapeState& state, double pixel = 0.0, float* distance = nullptr) {
+    typedef ScalarOps<Real> Ops;
+    if (Distance) *distance = 0.0f;
+    if (state.status == ESCAPE_ESCAPED) return state.iteration < iterations ? static_cast<float>(state.iteration) / iterations : 1.0f;
+    if (state.status == ESCAPE_INTERIOR || state.iteration >= iterations) return 1.0f;
+    bool checks = interior_checks();
+    if (Formula::bulbs && checks && state.iteration == 0 && in_main_bulbs(x, y)) {
+        state.status = ESCAPE_INTERIOR;
+        return 1.0f;
+    }
+    Real cr = Formula::julia ? static_cast<Real>(JULIA_REAL) : x;
+    Real ci = Formula::julia ? static_cast<Real>(JULIA_IMAG) : y;
+    Real zr = static_cast<Real>(state.real), zi = static_cast<Real>(state.imag);
+    if (Formula::julia && state.iteration == 0) {
+        zr = x;
+        zi = y;
+    }
+    Real zr2 = zr * zr, zi2 = zi * zi;
+    Real saved_r = zr, saved_i = zi;
+    Real dr = static_cast<Real>(Formula::julia ? 1 : 0), di = 0;
+    for (int i = state.iteration; i < iterations; ++i) {
+        if (Distance) Formula::template derive<Ops>(dr, di, zr, zi);
+        Formula::template step<Ops>(zr, zi, zr2, zi2, cr, ci);
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        if (zr2 + zi2 > static_cast<Real>(4)) {
+            state.iteration = i;
+            state.status = ESCAPE_ESCAPED;
+            if (Distance) return distance_value(escape_distance<Formula>(zr, zi, dr, di, cr, ci), pixel, *distance);
+            return static_cast<float>(i) / iterations;
+        }
+        if (checks) {
+            if (zr == saved_r && zi == saved_i) {
+                state.status = ESCAPE_INTERIOR;
+                return 1.0f;
+            }
+            if ((i & (i + 1)) == 0) {
+                saved_r = zr;
+                saved_i = zi;
+            }
+        }
+    }
+    state.real = zr;
+    state.imag = zi;
+    state.iteration = iterations;
+    return 1.0f;
+}
+
+float mandelbrot_point(double real, double imag, int iterations) {
+    EscapeState state = {};
+    return escape_orbit<MandelbrotFormula, double>(real, imag, iterations, state);
+}
+
+// Single-precision form for coarse views; the same steps in float.
+float mandelbrot_point_float(double real, double imag, int iterations) {
+    EscapeState state = {};
+    return escape_orbit<MandelbrotFormula, float>(static_cast<float>(real), static_cast<float>(imag), iterations, state);
+}
+
+// Distance estimate of the point from the Mandelbrot set, 0 if it stays
+// bounded
+float mandelbrot_point_distance(double real, double imag, int iterations) {
+    EscapeState state = {};
+    float distance;
+    escape_orbit<MandelbrotFormula, double, true>(real, imag, iterations, state, 1.0, &distance);
+    return distance;
+}
+
+// escape_orbit over a block, one sample at a time, for the targets without
+// a vector form
+template <class Formula, class Real, bool Distance = false>
+static void escape_grid(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    for (int j = 0; j < grid.rows; ++j) {
+        Real y = static_cast<Real>(grid.imag[j * grid.step_y]);
+        for (int i = 0; i < grid.columns; ++i) {
+            std::ptrdiff_t offset = j * out_stride + i * grid.step_x;
+            EscapeState fresh = {};
+            EscapeState& state = grid.state ? grid.state[offset] : fresh;
+            out[offset] = escape_orbit<Formula, Real, Distance>(static_cast<Real>(grid.real[i * grid.step_x]), y, iterations, state,
+                grid.pixel, Distance ? &grid.distance[offset] : nullptr);
+        }
+    }
+}
+
+// The test is inlined into the loop instead of being called per pixel
+template <float (*Point)(double, double, int)>
+static void evaluate_span_of(const double* real, double imag, int iterations, int count, int stride, float* out) {
+    for (int i = 0; i < count; ++i) {
+        float value = Point(real[i * stride], imag, iterations);
+        out[i * stride] = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    }
+}
+
+template <float (*Point)(double, double, int)>
+static void evaluate_grid_of(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    for (int j = 0; j < grid.rows; ++j) {
+        evaluate_span_of<Point>(grid.real, grid.imag[j * grid.step_y], iterations, grid.columns, grid.step_x, out + j * out_stride);
+    }
+}
+
+// Escape-time loop of Formula over a block for the vector type Lanes
+// describes (see math_avx2.cpp). The block is a queue: a lane whose pixel
+// escapes or reaches the cap writes its result and is reloaded with the
+// next pixel straight away, so one slow pixel does not hold the other
+// lanes idle.
+// Lanes left without a pixel sit at z = c = 0, which never escapes. Same
+// steps and interior checks as escape_orbit in Lanes::Scalar, so the
+// results match it bit for bit: pixels in the main bulbs, and with
+// grid.state those already settled, are answered at refill, and each lane
+// saves z whenever its count reaches its mark, which doubles each time.
+// With Distance the lanes carry the derivative too, and the escaped ones
+// are finished one at a time by escape_distance.
+template <class Formula, class Lanes, bool Distance = false>
+static void escape_lanes(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    typedef typename Lanes::Vec Vec;
+    typedef typename Lanes::Scalar Scalar;
+    if (grid.columns <= 0 || grid.rows <= 0) return;
+    if (iterations <= 0) {
+        for (int j = 0; j < grid.rows; ++j) {
+            for (int i = 0; i < grid.columns; ++i) {
+                out[j * out_stride + i * grid.step_x] = 1.0f;
+                if (Distance) grid.distance[j * out_stride + i * grid.step_x] = 0.0f;
+            }
+        }
+        return;
+    }
+    const Vec zero = Lanes::set1(0);
+    const Vec one = Lanes::set1(1);
+    const Vec four = Lanes::set1(4);
+    const Vec last = Lanes::set1(static_cast<Scalar>(iterations - 1));
+    const Vec start_d = Formula::julia ? one : zero;
+    const bool checks = interior_checks();
+
+    Scalar lane_cr[Lanes::count] = {}, lane_ci[Lanes::count] = {};
+    Scalar lane_zr[Lanes::count] = {}, lane_zi[Lanes::count] = {}, lane_start[Lanes::count] = {};
+    Scalar lane_n[Lanes::count], lane_dr[Lanes::count], lane_di[Lanes::count];
+    std::ptrdiff_t lane_out[Lanes::count];
+    int column = 0, row = 0; // next pixel in the queue
+    unsigned active = 0, escaped = 0, cycled = 0, done = (1u << Lanes::count) - 1;
+    Vec cr = zero, ci = zero, zr = zero, zi = zero, zr2 = zero, zi2 = zero, n = zero;
+    Vec saved_r = zero, saved_i = zero, mark = zero;
+    Vec dr = zero, di = zero;
+
+    for (;;) {
+        if (done) {
+            // Retire the finished lanes and refill them from the queue
+            Lanes::store(lane_n, n);
+            if (grid.state || Distance) {
+                Lanes::store(lane_zr, zr);
+                Lanes::store(lane_zi, zi);
+            }
+            if (Distance) {
+                Lanes::store(lane_dr, dr);
+                Lanes::store(lane_di, di);
+            }
+            for (int lane = 0; lane < Lanes::count; ++lane) {
+                if (!((done >> lane) & 1)) continue;
+                if ((active >> lane) & 1) {
+                    bool lane_escaped = (escaped >> lane) & 1;
+                    int steps = static_cast<int>(lane_n[lane]);
+                    if (Distance) {
+                        float& distance = grid.distance[lane_out[lane]];
+                        distance = 0.0f;
+                        out[lane_out[lane]] = lane_escaped ? distance_value(escape_distance<Formula>(lane_zr[lane], lane_zi[lane],
+                            lane_dr[lane], lane_di[lane], lane_cr[lane], lane_ci[lane]), grid.pixel, distance) : 1.0f;
+                    }
+                    else {
+                        out[lane_out[lane]] = lane_escaped ? static_cast<float>(steps - 1) / iterations : 1.0f;
+                    }
+                    if (grid.state) {
+                        EscapeState& state = grid.state[lane_out[lane]];
+                        if (lane_escaped) {
+                            state.iteration = steps - 1;
+                            state.status = ESCAPE_ESCAPED;
+                        }
+                        else if ((cycled >> lane) & 1) {
+                            state.status = ESCAPE_INTERIOR;
+                        }
+                        else {
+                            state.real = lane_zr[lane];
+                            state.imag = lane_zi[lane];
+                            state.iteration = steps;
+                        }
+                    }
+                }
+                active &= ~(1u << lane);
+                lane_cr[lane] = lane_ci[lane] = lane_zr[lane] = lane_zi[lane] = lane_start[lane] = 0;
+                while (row < grid.rows && !((active >> lane) & 1)) {
+                    Scalar pixel_cr = static_cast<Scalar>(grid.real[column * grid.step_x]);
+                    Scalar pixel_ci = static_cast<Scalar>(grid.imag[row * grid.step_y]);
+                    std::ptrdiff_t pixel_out = row * out_stride + column * grid.step_x;
+                    if (++column == grid.columns) {
+                        column = 0;
+                        ++row;
+                    }
+                    EscapeState fresh = {};
+                    EscapeState& state = grid.state ? grid.state[pixel_out] : fresh;
+                    if (state.status != ESCAPE_RUNNING || state.iteration >= iterations) {
+                        out[pixel_out] = state.status == ESCAPE_ESCAPED && state.iteration < iterations ?
+                            static_cast<float>(state.iteration) / iterations : 1.0f;
+                        continue;
+                    }
+                    if (Formula::bulbs && checks && state.iteration == 0 && in_main_bulbs(pixel_cr, pixel_ci)) {
+                        state.status = ESCAPE_INTERIOR;
+                        out[pixel_out] = 1.0f;
+                        if (Distance) grid.distance[pixel_out] = 0.0f;
+                        continue;
+                    }
+                    bool julia_start = Formula::julia && state.iteration == 0;
+                    lane_cr[lane] = Formula::julia ? static_cast<Scalar>(JULIA_REAL) : pixel_cr;
+                    lane_ci[lane] = Formula::julia ? static_cast<Scalar>(JULIA_IMAG) : pixel_ci;
+                    lane_zr[lane] = julia_start ? pixel_cr : static_cast<Scalar>(state.real);
+                    lane_zi[lane] = julia_start ? pixel_ci : static_cast<Scalar>(state.imag);
+                    lane_start[lane] = static_cast<Scalar>(state.iteration);
+                    lane_out[lane] = pixel_out;
+                    active |= 1u << lane;
+                }
+            }
+            if (!active) break;
+
+            // Refilled lanes start from their state (z = 0, or the sample
+            // for Julia, at step 0), and save that z for the cycle test
+            cr = Lanes::load(lane_cr);
+            ci = Lanes::load(lane_ci);
+            zr = Lanes::select(zr, Lanes::load(lane_zr), done);
+            zi = Lanes::select(zi, Lanes::load(lane_zi), done);
+            zr2 = Lanes::select(zr2, Lanes::mul(zr, zr), done);
+            zi2 = Lanes::select(zi2, Lanes::mul(zi, zi), done);
+            n = Lanes::select(n, Lanes::load(lane_start), done);
+            saved_r = Lanes::select(saved_r, zr, done);
+            saved_i = Lanes::select(saved_i, zi, done);
+            mark = Lanes::select(mark, n, done);
+            if (Distance) {
+                dr = Lanes::select(dr, start_d, done);
+                di = Lanes::select(di, zero, done);
+            }
+        }
+
+        if (Distance) Formula::template derive<Lanes>(dr, di, zr, zi);
+        Formula::template step<Lanes>(zr, zi, zr2, zi2, cr, ci);
+        zr2 = Lanes::mul(zr, zr);
+        zi2 = Lanes::mul(zi, zi);
+        escaped = Lanes::greater(Lanes::add(zr2, zi2), four) & active;
+        unsigned capped = Lanes::greater_equal(n, last) & active;
+        cycled = 0;
+        if (checks) {
+            cycled = Lanes::equal(zr, saved_r) & Lanes::equal(zi, saved_i) & active & ~escaped;
+            unsigned marked = Lanes::equal(n, mark) & active;
+            if (marked) {
+                saved_r = Lanes::select(saved_r, zr, marked);
+                saved_i = Lanes::select(saved_i, zi, marked);
+                mark = Lanes::select(mark, Lanes::add(Lanes::add(mark, mark), one), marked);
+            }
+        }
+        n = Lanes::add(n, one);
+        done = escaped | capped | cycled;
+    }
+}
+
+// Runs code over the FORMULA_LANES samples of the register file re/im,
+// each instruction across all of them before the next, so decoding it is
+// paid once per FORMULA_LANES samples. Arithmetic goes through Lanes (a
+// description as for escape_lanes, with div(), or ScalarOps<double>); the
+// transcendental functions are one sample at a time. Every lane chunk is
+// loaded before it is stored, so the target may be an operand.
+template <class Lanes>
+static void run_formula(const FormulaInstruction* code, int length, double (*re)[FORMULA_LANES], double (*im)[FORMULA_LANES]) {
+    typedef typename Lanes::Vec Vec;
+    const Vec zero = Lanes::set1(0);
+    const Vec two = Lanes::set1(2);
+    for (int k = 0; k < length; ++k) {
+        const FormulaInstruction& instruction = code[k];
+        const double* ar = re[instruction.a];
+        const double* ai = im[instruction.a];
+        const double* br = re[instruction.b];
+        const double* bi = im[instruction.b];
+        double* tr = re[instruction.target];
+        double* ti = im[instruction.target];
+        switch (instruction.op) {
+        case FORMULA_MOVE:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::load(ar + lane), i = Lanes::load(ai + lane);
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        case FORMULA_ADD:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::add(Lanes::load(ar + lane), Lanes::load(br + lane));
+                Vec i = Lanes::add(Lanes::load(ai + lane), Lanes::load(bi + lane));
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        case FORMULA_SUB:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::sub(Lanes::load(ar + lane), Lanes::load(br + lane));
+                Vec i = Lanes::sub(Lanes::load(ai + lane), Lanes::load(bi + lane));
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        case FORMULA_MUL:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec xr = Lanes::load(ar + lane), xi = Lanes::load(ai + lane);
+                Vec yr = Lanes::load(br + lane), yi = Lanes::load(bi + lane);
+                Lanes::store(tr + lane, Lanes::sub(Lanes::mul(xr, yr), Lanes::mul(xi, yi)));
+                Lanes::store(ti + lane, Lanes::add(Lanes::mul(xr, yi), Lanes::mul(xi, yr)));
+            }
+            break;
+        case FORMULA_DIV:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec xr = Lanes::load(ar + lane), xi = Lanes::load(ai + lane);
+                Vec yr = Lanes::load(br + lane), yi = Lanes::load(bi + lane);
+                Vec d = Lanes::add(Lanes::mul(yr, yr), Lanes::mul(yi, yi));
+                Lanes::store(tr + lane, Lanes::div(Lanes::add(Lanes::mul(xr, yr), Lanes::mul(xi, yi)), d));
+                Lanes::store(ti + lane, Lanes::div(Lanes::sub(Lanes::mul(xi, yr), Lanes::mul(xr, yi)), d));
+            }
+            break;
+        case FORMULA_SQUARE:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec xr = Lanes::load(ar + lane), xi = Lanes::load(ai + lane);
+                Lanes::store(tr + lane, Lanes::sub(Lanes::mul(xr, xr), Lanes::mul(xi, xi)));
+                Lanes::store(ti + lane, Lanes::mul(Lanes::mul(two, xr), xi));
+            }
+            break;
+        case FORMULA_NEGATE:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::sub(zero, Lanes::load(ar + lane)), i = Lanes::sub(zero, Lanes::load(ai + lane));
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        case FORMULA_CONJUGATE:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::load(ar + lane), i = Lanes::sub(zero, Lanes::load(ai + lane));
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        case FORMULA_FOLD:
+            for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+                Vec r = Lanes::abs(Lanes::load(ar + lane)), i = Lanes::abs(Lanes::load(ai + lane));
+                Lanes::store(tr + lane, r);
+                Lanes::store(ti + lane, i);
+            }
+            break;
+        default:
+            for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                double x = ar[lane], y = ai[lane];
+                switch (instruction.op) {
+                case FORMULA_EXP: {
+                    double e = std::exp(x);
+                    tr[lane] = e * std::cos(y);
+                    ti[lane] = e * std::sin(y);
+                    break;
+                }
+                case FORMULA_LOG:
+                    tr[lane] = 0.5 * std::log(x * x + y * y);
+                    ti[lane] = std::atan2(y, x);
+                    break;
+                case FORMULA_SIN:
+                    tr[lane] = std::sin(x) * std::cosh(y);
+                    ti[lane] = std::cos(x) * std::sinh(y);
+                    break;
+                case FORMULA_COS:
+                    tr[lane] = std::cos(x) * std::cosh(y);
+                    ti[lane] = -std::sin(x) * std::sinh(y);
+                    break;
+                case FORMULA_SINH:
+                    tr[lane] = std::sinh(x) * std::cos(y);
+                    ti[lane] = std::cosh(x) * std::sin(y);
+                    break;
+                case FORMULA_COSH:
+                    tr[lane] = std::cosh(x) * std::cos(y);
+                    ti[lane] = std::sinh(x) * std::sin(y);
+                    break;
+                default:
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+// User formula over a block (see FormulaCode), FORMULA_LANES samples at a
+// time through run_formula, normalised like escape_orbit. As in
+// escape_lanes the block is a queue: a sample that escapes or reaches the
+// cap hands its lane to the next one straight away. Idle lanes sit at
+// z = c = 0. The start code runs whenever lanes are refilled, and the z of
+// the lanes that were not is put back after it. Lanes count their
+// iterations from the step they joined on, so only the escape test runs
+// every step; the cap is checked when the earliest lane reaches it.
+template <class Lanes>
+static void formula_lanes(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    if (grid.columns <= 0 || grid.rows <= 0) return;
+    const FormulaCode& formula = *grid.formula;
+    double re[FORMULA_REGISTERS][FORMULA_LANES] = {}, im[FORMULA_REGISTERS][FORMULA_LANES] = {};
+    for (int k = 0; k < formula.constants; ++k) {
+        for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+            re[FORMULA_CONSTANTS + k][lane] = formula.constant_real[k];
+            im[FORMULA_CONSTANTS + k][lane] = formula.constant_imag[k];
+        }
+    }
+    double* zr = re[FORMULA_Z];
+    double* zi = im[FORMULA_Z];
+    double* cr = re[FORMULA_C];
+    double* ci = im[FORMULA_C];
+
+    typedef typename Lanes::Vec Vec;
+    const Vec four = Lanes::set1(4);
+    const unsigned chunk = (1u << Lanes::count) - 1;
+    int lane_begin[FORMULA_LANES] = {};
+    std::ptrdiff_t lane_out[FORMULA_LANES] = {};
+    int column = 0, row = 0; // next pixel in the queue
+    int step = 0, next_cap = 0;
+    unsigned active = 0, done = (1u << FORMULA_LANES) - 1;
+    for (;;) {
+        if (done) {
+            unsigned refilled = 0;
+            for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                if (!((done >> lane) & 1)) continue;
+                zr[lane] = zi[lane] = cr[lane] = ci[lane] = 0.0;
+                while (row < grid.rows) {
+                    double pixel_cr = grid.real[column * grid.step_x];
+                    double pixel_ci = grid.imag[row * grid.step_y];
+                    std::ptrdiff_t pixel_out = row * out_stride + column * grid.step_x;
+                    if (++column == grid.columns) {
+                        column = 0;
+                        ++row;
+                    }
+                    if (iterations <= 0) {
+                        out[pixel_out] = 1.0f;
+                        continue;
+                    }
+                    cr[lane] = pixel_cr;
+                    ci[lane] = pixel_ci;
+                    lane_begin[lane] = step;
+                    lane_out[lane] = pixel_out;
+                    refilled |= 1u << lane;
+                    break;
+                }
+            }
+            active = (active & ~done) | refilled;
+            if (!active) break;
+            next_cap = step + iterations;
+            for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                if (((active >> lane) & 1) && lane_begin[lane] + iterations < next_cap) next_cap = lane_begin[lane] + iterations;
+            }
+            if (formula.start_length && refilled) {
+                double kept_r[FORMULA_LANES], kept_i[FORMULA_LANES];
+                for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                    kept_r[lane] = zr[lane];
+                    kept_i[lane] = zi[lane];
+                }
+                run_formula<Lanes>(formula.start, formula.start_length, re, im);
+                for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                    if ((refilled >> lane) & 1) continue;
+                    zr[lane] = kept_r[lane];
+                    zi[lane] = kept_i[lane];
+                }
+            }
+        }
+
+        run_formula<Lanes>(formula.step, formula.step_length, re, im);
+        unsigned escaped = 0;
+        for (int lane = 0; lane < FORMULA_LANES; lane += Lanes::count) {
+            Vec xr = Lanes::load(zr + lane), xi = Lanes::load(zi + lane);
+            Vec magnitude = Lanes::add(Lanes::mul(xr, xr), Lanes::mul(xi, xi));
+            // A z gone NaN counts as escaped
+            escaped |= (Lanes::greater(magnitude, four) | (~Lanes::equal(magnitude, magnitude) & chunk)) << lane;
+        }
+        escaped &= active;
+        ++step;
+        done = escaped;
+        if (step == next_cap) {
+            for (int lane = 0; lane < FORMULA_LANES; ++lane) {
+                if (((active >> lane) & 1) && step - lane_begin[lane] == iterations) done |= 1u << lane;
+            }
+        }
+        for (int lane = 0; done && lane < FORMULA_LANES; ++lane) {
+            if (!((done >> lane) & 1)) continue;
+            out[lane_out[lane]] = (escaped >> lane) & 1 ? static_cast<float>(step - 1 - lane_begin[lane]) / iterations : 1.0f;
+        }
+    }
+}
+
+// Perturbation: c = C + dc is iterated as z = Z + dz against the reference
+// orbit Z of C, with dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc, so only the small
+// offsets need to fit in a double. A sample whose |z| drops far below |Z|
+// has lost the bits of dz that matter (a glitch), as has one still going
+// when the reference escapes; both come out negative, as minus the
+// iterations they got through (plus one) over the cap.
+//
+// With Distance the derivative of the sample's own orbit Z + dz is
+// carried along in double, and escape_distance finishes it from there with
+// c = Z_1 + dc; the result is then distance_value's.
+template <bool Distance>
+static float perturbed_point(const ReferenceOrbit& orbit, double dcr, double dci, int iterations, double pixel, float* distance) {
+    double dr = 0.0, di = 0.0, deriv_r = 0.0, deriv_i = 0.0;
+    int limit = iterations < orbit.length - 1 ? iterations : orbit.length - 1;
+    if (Distance) *distance = 0.0f;
+    for (int n = 0; n < limit; ++n) {
+        double zr = orbit.real[n], zi = orbit.imag[n];
+        if (Distance) MandelbrotFormula::derive<ScalarOps<double> >(deriv_r, deriv_i, zr + dr, zi + di);
+        double next_dr = 2.0 * (zr * dr - zi * di) + (dr * dr - di * di) + dcr;
+        double next_di = 2.0 * (zr * di + zi * dr) + 2.0 * dr * di + dci;
+        dr = next_dr;
+        di = next_di;
+        double xr = orbit.real[n + 1] + dr, xi = orbit.imag[n + 1] + di;
+        double magnitude = xr * xr + xi * xi;
+        if (magnitude > 4.0) {
+            if (Distance) {
+                double distance_estimate = escape_distance<MandelbrotFormula>(xr, xi, deriv_r, deriv_i, orbit.real[1] + dcr, orbit.imag[1] + dci);
+                return distance_value(distance_estimate, pixel, *distance);
+            }
+            return static_cast<float>(n) / iterations;
+        }
+        if (orbit.glitch[n + 1] > magnitude) return -static_cast<float>(n + 1) / iterations;
+    }
+    return limit == iterations ? 1.0f : -static_cast<float>(limit + 1) / iterations;
+}
+
+template <bool Distance>
+static void perturbed_grid(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    for (int j = 0; j < grid.rows; ++j) {
+        for (int i = 0; i < grid.columns; ++i) {
+            std::ptrdiff_t offset = j * out_stride + i * grid.step_x;
+            out[offset] = perturbed_point<Distance>(*grid.reference, grid.real[i * grid.step_x], grid.imag[j * grid.step_y], iterations,
+                grid.pixel, Distance ? &grid.distance[offset] : nullptr);
+        }
+    }
+}
+
+// perturbed_point on Lanes::count samples at a time. All lanes share the
+// iteration number, so Z_n is a broadcast rather than a gather; the group
+// ends when its last lane does. Same steps, so the same results.
+template <class Lanes, bool Distance>
+static void perturbed_lanes(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    typedef typename Lanes::Vec Vec;
+    typedef typename Lanes::Scalar Scalar;
+    const ReferenceOrbit& orbit = *grid.reference;
+    const Vec zero = Lanes::set1(0);
+    const Vec two = Lanes::set1(2);
+    const Vec four = Lanes::set1(4);
+    const int limit = iterations < orbit.length - 1 ? iterations : orbit.length - 1;
+    const int count = grid.columns * grid.rows;
+
+    for (int first = 0; first < count; first += Lanes::count) {
+        Scalar lane_dcr[Lanes::count] = {}, lane_dci[Lanes::count] = {};
+        Scalar lane_zr[Lanes::count], lane_zi[Lanes::count], lane_deriv_r[Lanes::count], lane_deriv_i[Lanes::count];
+        float lane_value[Lanes::count], lane_distance[Lanes::count] = {};
+        std::ptrdiff_t lane_out[Lanes::count];
+        unsigned active = 0;
+        for (int lane = 0; lane < Lanes::count && first + lane < count; ++lane) {
+            int column = (first + lane) % grid.columns, row = (first + lane) / grid.columns;
+            lane_dcr[lane] = grid.real[column * grid.step_x];
+            lane_dci[lane] = grid.imag[row * grid.step_y];
+            lane_out[lane] = row * out_stride + column * grid.step_x;
+            lane_value[lane] = limit == iterations ? 1.0f : -static_cast<float>(limit + 1) / iterations;
+            active |= 1u << lane;
+        }
+
+        const Vec dcr = Lanes::load(lane_dcr), dci = Lanes::load(lane_dci);
+        Vec dr = zero, di = zero, deriv_r = zero, deriv_i = zero;
+        unsigned live = active;
+        for (int n = 0; n < limit && live; ++n) {
+            const Vec zr = Lanes::set1(orbit.real[n]), zi = Lanes::set1(orbit.imag[n]);
+            if (Distance) MandelbrotFormula::derive<Lanes>(deriv_r, deriv_i, Lanes::add(zr, dr), Lanes::add(zi, di));
+            Vec next_dr = Lanes::add(Lanes::add(Lanes::mul(two, Lanes::sub(Lanes::mul(zr, dr), Lanes::mul(zi, di))),
+                Lanes::sub(Lanes::mul(dr, dr), Lanes::mul(di, di))), dcr);
+            Vec next_di = Lanes::add(Lanes::add(Lanes::mul(two, Lanes::add(Lanes::mul(zr, di), Lanes::mul(zi, dr))),
+                Lanes::mul(Lanes::mul(two, dr), di)), dci);
+            dr = next_dr;
+            di = next_di;
+            Vec xr = Lanes::add(Lanes::set1(orbit.real[n + 1]), dr), xi = Lanes::add(Lanes::set1(orbit.imag[n + 1]), di);
+            Vec magnitude = Lanes::add(Lanes::mul(xr, xr), Lanes::mul(xi, xi));
+            unsigned escaped = Lanes::greater(magnitude, four) & live;
+            unsigned glitched = Lanes::greater(Lanes::set1(orbit.glitch[n + 1]), magnitude) & live & ~escaped;
+            if (escaped | glitched) {
+                if (Distance && escaped) {
+                    Lanes::store(lane_zr, xr);
+                    Lanes::store(lane_zi, xi);
+                    Lanes::store(lane_deriv_r, deriv_r);
+                    Lanes::store(lane_deriv_i, deriv_i);
+                }
+                for (int lane = 0; lane < Lanes::count; ++lane) {
+                    if ((escaped >> lane) & 1) {
+                        lane_value[lane] = Distance ? distance_value(escape_distance<MandelbrotFormula>(lane_zr[lane], lane_zi[lane],
+                            lane_deriv_r[lane], lane_deriv_i[lane], orbit.real[1] + lane_dcr[lane], orbit.imag[1] + lane_dci[lane]),
+                            grid.pixel, lane_distance[lane]) : static_cast<float>(n) / iterations;
+                    }
+                    else if ((glitched >> lane) & 1) {
+                        lane_value[lane] = -static_cast<float>(n + 1) / iterations;
+                    }
+                }
+                live &= ~(escaped | glitched);
+            }
+        }
+        for (int lane = 0; lane < Lanes::count; ++lane) {
+            if (!((active >> lane) & 1)) continue;
+            out[lane_out[lane]] = lane_value[lane];
+            if (Distance) grid.distance[lane_out[lane]] = lane_distance[lane];
+        }
+    }
+}
+
+// The escape-time family over a block (see evaluate_block in math.h) in
+// double, with or without distance estimation, and in float, the
+// Mandelbrot set by perturbation and user formulas, defined by each
+// including file with the widest vector form its target has. Must match
+// escape_orbit, perturbed_point and formula_lanes over ScalarOps<double>
+// bit for bit.
+template <class Formula, bool Distance>
+static void escape_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+template <class Formula>
+static void escape_block_float(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+template <bool Distance>
+static void mandelbrot_block_perturbed(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+static void formula_block(const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride);
+
+// Distance estimation runs in double whatever the precision, as the
+// derivative soon outgrows float, and from scratch, as states keep none.
+template <class Formula>
+static void escape_kernel(Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    if (grid.distance && Formula::distance) {
+        SampleGrid fresh = grid;
+        fresh.state = nullptr;
+        escape_block<Formula, Formula::distance>(fresh, iterations, out, out_stride);
+    }
+    else if (precision == PRECISION_FLOAT) {
+        escape_block_float<Formula>(grid, iterations, out, out_stride);
+    }
+    else {
+        escape_block<Formula, false>(grid, iterations, out, out_stride);
+    }
+}
+
+// escape_kernel with the formula of type; false if type is not one of the
+// escape-time family
+static bool escape_time_kernel(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    switch (type) {
+    case MANDELBROT: escape_kernel<MandelbrotFormula>(precision, grid, iterations, out, out_stride); return true;
+    case JULIA: escape_kernel<JuliaFormula>(precision, grid, iterations, out, out_stride); return true;
+    case MULTIBROT: escape_kernel<MultibrotFormula>(precision, grid, iterations, out, out_stride); return true;
+    case BURNING_SHIP: escape_kernel<BurningShipFormula>(precision, grid, iterations, out, out_stride); return true;
+    case TRICORN: escape_kernel<TricornFormula>(precision, grid, iterations, out, out_stride); return true;
+    default: return false;
+    }
+}
+
+void span_kernel(FractalType type, const double* real, double imag, int iterations, int count, int stride, float* out) {
+    switch (type) {
+    case MANDELBROT: case JULIA: case MULTIBROT: case BURNING_SHIP: case TRICORN: {
+        SampleGrid grid = {};
+        grid.real = real;
+        grid.columns = count;
+        grid.step_x = stride;
+        grid.imag = &imag;
+        grid.rows = 1;
+        escape_time_kernel(type, PRECISION_DOUBLE, grid, iterations, out, 0);
+        break;
+    }
+    case SIERPINSKI_CARPET: evaluate_span_of<sierpinski_carpet>(real, imag, iterations, count, stride, out); break;
+    case CANTOR: evaluate_span_of<cantor_dust>(real, imag, iterations, count, stride, out); break;
+    case PEANO: evaluate_span_of<peano_curve>(real, imag, iterations, count, stride, out); break;
+    case HILBERT: evaluate_span_of<hilbert_curve>(real, imag, iterations, count, stride, out); break;
+    case SIERPINSKI_TRIANGLE: evaluate_span_of<sierpinski_triangle>(real, imag, iterations, count, stride, out); break;
+    case BOX: evaluate_span_of<box_fractal>(real, imag, iterations, count, stride, out); break;
+    case CANTOR_TERNARY: evaluate_span_of<cantor_ternary_grid>(real, imag, iterations, count, stride, out); break;
+    case SIERPINSKI_HEXAGON: evaluate_span_of<sierpinski_hexagon>(real, imag, iterations, count, stride, out); break;
+    case CANTOR_MAZE: evaluate_span_of<cantor_maze>(real, imag, iterations, count, stride, out); break;
+    case PEANO_MEANDER: evaluate_span_of<peano_meander_curve>(real, imag, iterations, count, stride, out); break;
+    case VICSEK: evaluate_span_of<vicsek_fractal>(real, imag, iterations, count, stride, out); break;
+    case HEXAFLAKE: evaluate_span_of<hexaflake>(real, imag, iterations, count, stride, out); break;
+    case CANTOR_SQUARE: evaluate_span_of<cantor_square>(real, imag, iterations, count, stride, out); break;
+    case HILBERT_VARIANT: evaluate_span_of<hilbert_variant>(real, imag, iterations, count, stride, out); break;
+    case SIERPINSKI_PENTAGON: evaluate_span_of<sierpinski_pentagon>(real, imag, iterations, count, stride, out); break;
+    case CANTOR_CLOUD: evaluate_span_of<cantor_cloud>(real, imag, iterations, count, stride, out); break;
+    case MOORE: evaluate_span_of<moore_curve>(real, imag, iterations, count, stride, out); break;
+    case SIERPINSKI_SQUARE: evaluate_span_of<sierpinski_square>(real, imag, iterations, count, stride, out); break;
+    default:
+        for (int i = 0; i < count; ++i) out[i * stride] = 0.1f;
+        break;
+    }
+}
+
+void block_kernel(FractalType type, Precision precision, const SampleGrid& grid, int iterations, float* out, std::ptrdiff_t out_stride) {
+    // Any other type would read the offsets as absolute coordinates
+    assert(precision != PRECISION_PERTURBATION || type == MANDELBROT);
+    if (type == MANDELBROT && precision == PRECISION_PERTURBATION) {
+        if (grid.distance) mandelbrot_block_perturbed<true>(grid, iterations, out, out_stride);
+        else mandelbrot_block_perturbed<false>(grid, iterations, out, out_stride);
+        return;
+    }
+    if (type == USER_FORMULA && grid.formula) {
+        formula_block(grid, iterations, out, out_stride);
+        return;
+    }
+    if (escape_time_kernel(type, precision, grid, iterations, out, out_stride)) return;
+    for (int j = 0; j < grid.rows; ++j) {
+        span_kernel(type, grid.real, grid.imag[j * grid.step_y], iterations, grid.columns, grid.step_x, out + j * out_stride);
+    }
+}
@@ -0,0 +1,808 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "formula.h"
+
+#define PAN_SPAN_TOLERANCE 1e-9  // relative change in span still treated as a pure pan
+#define PAN_PIXEL_TOLERANCE 1e-3 // fraction of a pixel a pan may be off the pixel grid
+#define REPROJECT_EXACT_TOLERANCE 1e-6 // pixels; closer old samples are reused as final
+#define FLOAT_MIN_SPACING 1.52587890625e-5  // 2^-16: finest pixel spacing float resolves, relative to the coordinates
+#define DOUBLE_MIN_SPACING 5.6843418860808e-14 // 2^-44: the same for double
+#define CLASSIFY_MARGIN_FLOAT 1e-3  // relative slack around |z|^2 = 4 when boxes stand in for float samples
+#define CLASSIFY_MARGIN_DOUBLE 1e-9 // the same for double samples
+#define PERTURBATION_MAX_REFERENCES 16 // extra reference orbits a tile may take for its glitched samples
+
+bool is_pixel_fractal(FractalType type) {
+	return type == SIERPINSKI_CARPET || type == CANTOR ||
+		type == PEANO || type == HILBERT ||
+		type == SIERPINSKI_TRIANGLE || type == BOX ||
+		type == CANTOR_TERNARY || type == SIERPINSKI_HEXAGON ||
+		type == CANTOR_MAZE || type == PEANO_MEANDER ||
+		type == VICSEK || type == HEXAFLAKE ||
+		type == CANTOR_SQUARE || type == HILBERT_VARIANT ||
+		type == SIERPINSKI_PENTAGON || type == CANTOR_CLOUD ||
+		type == MOORE || type == SIERPINSKI_SQUARE;
+}
+
+bool is_escape_time(FractalType type) {
+	return type == MANDELBROT || type == JULIA || type == MULTIBROT ||
+		type == BURNING_SHIP || type == TRICORN;
+}
+
+bool has_distance_estimate(FractalType type) {
+	return type == MANDELBROT || type == JULIA || type == MULTIBROT;
+}
+
+// Keys whose samples are distance estimates
+static bool estimates_distance(const RenderKey& key) {
+	return key.distance && has_distance_estimate(key.type);
+}
+
+bool keeps_escape_state(const RenderKey& key, Precision precision) {
+	return is_escape_time(key.type) && !estimates_distance(key) && (precision == PRECISION_FLOAT || precision == PRECISION_DOUBLE);
+}
+
+// Keys of the same fractal, down to the program of a user formula, shown
+// the same way
+static bool same_fractal(const RenderKey& a, const RenderKey& b) {
+	return a.type == b.type && a.formula == b.formula && estimates_distance(a) == estimates_distance(b);
+}
+
+// Distance between neighbouring pixels of key in the plane, the larger way
+static double pixel_spacing(const RenderKey& key) {
+	return std::max(key.view.width() / key.width, key.view.height() / key.height);
+}
+
+// Keys whose pixels have the same orbits, whatever their caps
+static bool same_orbits(const RenderKey& a, const RenderKey& b) {
+	return same_fractal(a, b) && a.view == b.view && a.width == b.width && a.height == b.height;
+}
+
+int fractal_iterations(FractalType type, int requested) {
+	return is_pixel_fractal(type) ? PIXEL_FRACTAL_DEPTH : requested;
+}
+
+Precision resolve_precision(const RenderKey& key) {
+	if (is_pixel_fractal(key.type) || key.type == USER_FORMULA) return PRECISION_DOUBLE;
+	Precision precision = key.precision;
+	if (precision == PRECISION_AUTO) {
+		// Each tier keeps about 8 bits below the pixel spacing for the
+		// rounding that builds up over the iterations
+		DoubleViewport flat = key.view.bounds<double>();
+		double spacing = pixel_spacing(key);
+		double magnitude = std::max({ 2.0, std::fabs(flat.x_min), std::fabs(flat.x_max), std::fabs(flat.y_min), std::fabs(flat.y_max) });
+		if (spacing > FLOAT_MIN_SPACING * magnitude) precision = PRECISION_FLOAT;
+		else if (spacing > DOUBLE_MIN_SPACING * magnitude) precision = PRECISION_DOUBLE;
+		else precision = PRECISION_PERTURBATION;
+	}
+	// Only the Mandelbrot kernels iterate offsets from a reference orbit
+	if (precision == PRECISION_PERTURBATION && key.type != MANDELBROT) precision = PRECISION_DOUBLE_DOUBLE;
+	// The derivative of an orbit soon outgrows float
+	if (precision == PRECISION_FLOAT && estimates_distance(key)) precision = PRECISION_DOUBLE;
+	return precision;
+}
+
+const char* precision_name(Precision precision) {
+	switch (precision) {
+	case PRECISION_AUTO: return "auto";
+	case PRECISION_FLOAT: return "float";
+	case PRECISION_DOUBLE: return "double";
+	case PRECISION_DOUBLE_DOUBLE: return "double-double";
+	case PRECISION_PERTURBATION: return "perturbation";
+	}
+	return "unknown";
+}
+
+double resolve_frame_budget(int argc, char* argv[]) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::strcmp(argv[i], "--frame-budget") == 0) {
+			double budget = std::atof(argv[i + 1]);
+			if (budget > 0.0) return budget;
+		}
+	}
+	if (const char* env = std::getenv("FRACTAL_FRAME_BUDGET")) {
+		double budget = std::atof(env);
+		if (budget > 0.0) return budget;
+	}
+	return 0.0;
+}
+
+Renderer::Renderer(int width, int height, int thread_count)
+	: width(width), height(height), pool(thread_count), scheduler(pool.size()), tiles(make_tiles(width, height)),
+	frame(width, height), focus_x(0.5 * width), focus_y(0.5 * height), present_count(0),
+	used_precision(PRECISION_DOUBLE) {
+}
+
+bool Renderer::render(const RenderKey& key) {
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(frame_budget));
+
+	if (!has_job || job_key != key) {
+		if (begin(key)) {
+			present();
+			return true;
+		}
+	}
+	else if (pass_tiles.empty()) {
+		return false;
+	}
+
+	run_pass(key);
+	if (!job_presentable) return false;
+	present();
+	return true;
+}
+
+// Sets up the back buffer and the work for a new key. Returns true when the
+// back buffer already holds something worth presenting.
+bool Renderer::begin(const RenderKey& key) {
+	// Pixels kept from the front frame must come from the same arithmetic
+	Precision precision = resolve_precision(key);
+	int dx = 0, dy = 0;
+	bool pan = front_complete && precision == front_precision && pan_offset(key, dx, dy);
+
+	// Frames are cached when the view leaves them, so the intermediate
+	// steps of a drag do not flush the LRU.
+	if (front_complete && !front_cached && !pan) {
+		cache.store(front_key, frame.front());
+		front_cached = true;
+	}
+
+	has_job = true;
+	job_key = key;
+	job_precision = precision;
+	used_precision = precision;
+	reference_ready = false;
+	job_presentable = false;
+	job_cached = false;
+	reuse_exact = false;
+	job_keeps_state = job_resumes = false;
+	job_estimates = estimates_distance(key);
+	pass_step = first_step = 1;
+
+	FrameBuffer& target = frame.back();
+	if (const FrameBuffer* cached = cache.find(key)) {
+		target = *cached;
+		job_tiles.clear();
+		pass_tiles.clear();
+		job_presentable = job_cached = true;
+		return true;
+	}
+	if (job_estimates) distance_estimate.resize(static_cast<std::size_t>(target.stride()) * height);
+	job_keeps_state = keeps_escape_state(key, precision);
+	job_resumes = job_keeps_state && state_whole && precision == state_precision && same_orbits(key, state_key);
+	if (job_resumes) {
+		// Only the cap changed: the old picture stands in while the orbits
+		// carry on (or are recoloured, for a lower cap)
+		state_key = key;
+		if (has_front && same_orbits(front_key, key)) {
+			target = frame.front();
+			job_presentable = true;
+		}
+		job_tiles = tiles;
+		prioritize(job_tiles);
+		pass_tiles = job_tiles;
+		return false;
+	}
+	if (job_keeps_state) start_escape_state(key, dx, dy, pan);
+	if (pan) {
+		target.shift_from(frame.front(), dx, dy);
+		job_tiles = exposed_tiles(dx, dy);
+		prioritize(job_tiles);
+		pass_tiles = job_tiles;
+		return false;
+	}
+	if (can_reproject(key)) {
+		reproject(key);
+		pass_tiles = job_tiles;
+		job_presentable = true;
+		return true;
+	}
+
+	job_tiles = tiles;
+	prioritize(job_tiles);
+	pass_tiles = job_tiles;
+	pass_step = first_step = (progressive || frame_budget > 0.0) ? PROGRESSIVE_START_STEP : 1;
+	return false;
+}
+
+// Works through the current pass; moves on to the next finer one when it
+// completes, or leaves the untouched tiles in pass_tiles if interrupted.
+void Renderer::run_pass(const RenderKey& key) {
+	// A coarse first pass is cheap and is the only way something gets on
+	// screen while views keep being superseded, so it always runs to the end.
+	bool interruptible = job_presentable || pass_step == 1;
+	compute_tiles(key, frame.back(), pass_tiles, pass_step, interruptible);
+	if (!pass_tiles.empty()) return;
+	if (job_keeps_state && pass_step == first_step) state_whole = true;
+
+	// A completed pass leaves a whole (if coarse) picture behind
+	job_presentable = true;
+	if (pass_step > 1) {
+		pass_step /= 2;
+		pass_tiles = job_tiles;
+	}
+	else {
+		reuse_exact = false;
+	}
+}
+
+void Renderer::compute_fractal(const RenderKey& key) {
+	has_job = true;
+	job_key = key;
+	job_precision = resolve_precision(key);
+	used_precision = job_precision;
+	reference_ready = false;
+	job_tiles = tiles;
+	job_presentable = true;
+	job_cached = false;
+	reuse_exact = false;
+	job_estimates = estimates_distance(key);
+	if (job_estimates) distance_estimate.resize(static_cast<std::size_t>(frame.back().stride()) * height);
+	job_keeps_state = keeps_escape_state(key, job_precision);
+	job_resumes = false;
+	if (job_keeps_state) start_escape_state(key, 0, 0, false);
+	pass_step = first_step = 1;
+	compute_tiles(key, frame.back(), job_tiles, 1, false);
+	state_whole = job_keeps_state;
+	job_tiles.clear();
+	pass_tiles.clear();
+	present();
+}
+
+// Points escape_state at key's view. A pan keeps the state of the pixels
+// it keeps, if that is the front view's; every other pixel is cleared by
+// the job's first pass.
+void Renderer::start_escape_state(const RenderKey& key, int dx, int dy, bool pan) {
+	int stride = frame.back().stride();
+	escape_state.resize(static_cast<std::size_t>(stride) * height);
+	if (pan && state_whole && state_precision == job_precision && same_orbits(state_key, front_key)) {
+		// In place, walking rows as FrameBuffer::shift_from does
+		int x_begin = std::max(0, -dx), x_end = std::min(width, width - dx);
+		int y_begin = std::max(0, -dy), y_end = std::min(height, height - dy);
+		std::size_t bytes = static_cast<std::size_t>(std::max(x_end - x_begin, 0)) * sizeof(EscapeState);
+		for (int i = 0; i < y_end - y_begin && bytes; ++i) {
+			int y = dy >= 0 ? y_begin + i : y_end - 1 - i;
+			EscapeState* row = &escape_state[static_cast<std::size_t>(y) * stride];
+			std::memmove(row + x_begin, row + static_cast<std::ptrdiff_t>(dy) * stride + x_begin + dx, bytes);
+		}
+	}
+	else if (pan) {
+		std::fill(escape_state.begin(), escape_state.end(), EscapeState());
+	}
+	state_key = key;
+	state_precision = job_precision;
+	state_whole = false;
+}
+
+void Renderer::clear_escape_state(const Tile& tile) {
+	int stride = frame.back().stride();
+	for (int y = tile.y0; y < tile.y1; ++y) {
+		EscapeState* row = &escape_state[static_cast<std::size_t>(y) * stride];
+		std::fill(row + tile.x0, row + tile.x1, EscapeState());
+	}
+}
+
+void Renderer::set_focus(double x, double y) {
+	if (x == focus_x && y == focus_y) return;
+	focus_x = x;
+	focus_y = y;
+	prioritize(job_tiles);
+	prioritize(pass_tiles);
+}
+
+// One block evaluation over the samples of tile from (x0, y0) at the given
+// spacings, so the kernel can keep its vector lanes busy across the tile.
+void Renderer::compute_grid(const RenderKey& key, FrameBuffer& target, const Tile& tile, int x0, int step_x, int y0, int step_y) {
+	if (x0 >= tile.x1 || y0 >= tile.y1) return;
+	compute_samples(key, target, x0, (tile.x1 - x0 + step_x - 1) / step_x, step_x, y0, (tile.y1 - y0 + step_y - 1) / step_y, step_y);
+}
+
+void Renderer::compute_samples(const RenderKey& key, FrameBuffer& target, int x0, int columns, int step_x, int y0, int rows, int step_y) {
+	bool split = job_precision == PRECISION_DOUBLE_DOUBLE;
+	FormulaCode formula = {};
+	if (key.formula) formula = key.formula->code();
+	SampleGrid grid = {
+		&column_real[x0], split ? &column_real_lo[x0] : nullptr, columns, step_x,
+		&row_imag[y0], split ? &row_imag_lo[y0] : nullptr, rows, step_y,
+		job_precision == PRECISION_PERTURBATION ? &reference_orbit : nullptr,
+		job_keeps_state ? &escape_state[static_cast<std::size_t>(y0) * target.stride() + x0] : nullptr,
+		key.formula ? &formula : nullptr,
+		job_estimates ? &distance_estimate[static_cast<std::size_t>(y0) * target.stride() + x0] : nullptr,
+		pixel_spacing(key),
+	};
+	evaluate_block(key.type, job_precision, grid, key.iterations, target.row(y0) + x0, static_cast<std::ptrdiff_t>(step_y) * target.stride());
+}
+
+// Least distance estimate on the border of the rectangle with corner
+// samples (x0, y0) and (x1, y1)
+float Renderer::border_distance(const FrameBuffer& target, int x0, int y0, int x1, int y1, int step) const {
+	const float* top = &distance_estimate[static_cast<std::size_t>(y0) * target.stride()];
+	const float* bottom = &distance_estimate[static_cast<std::size_t>(y1) * target.stride()];
+	float nearest = top[x0];
+	for (int x = x0; x <= x1; x += step) nearest = std::min({ nearest, top[x], bottom[x] });
+	for (int y = y0 + step; y < y1; y += step) {
+		const float* row = &distance_estimate[static_cast<std::size_t>(y) * target.stride()];
+		nearest = std::min({ nearest, row[x0], row[x1] });
+	}
+	return nearest;
+}
+
+// Row by row around the pixels reprojection made final.
+void Renderer::compute_rows(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step) {
+	for (int y = tile.y0; y < tile.y1; y += step) {
+		if (exact_row[y] < 0) {
+			compute_samples(key, target, tile.x0, (tile.x1 - tile.x0 + step - 1) / step, step, y, 1, step);
+			continue;
+		}
+		int x = tile.x0;
+		while (x < tile.x1) {
+			while (x < tile.x1 && exact_col[x] >= 0) x += step;
+			int run = x;
+			while (x < tile.x1 && exact_col[x] < 0) x += step;
+			if (x > run) {
+				compute_samples(key, target, run, (x - run + step - 1) / step, step, y, 1, step);
+			}
+		}
+	}
+}
+
+// Re-evaluates the samples of tile the view centre's orbit left glitched
+// against a reference inside the tile: the glitched sample that got
+// furthest, whose orbit then covers its neighbours for longest. Each round
+// fixes the samples the new reference resolves; whatever is still glitched
+// after PERTURBATION_MAX_REFERENCES rounds is taken to be inside the set.
+void Renderer::resolve_glitches(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step) {
+	const Viewport& view = key.view;
+	std::vector<int> glitched_x, glitched_y;
+	for (int y = tile.y0; y < tile.y1; y += step) {
+		const float* row = target.row(y);
+		for (int x = tile.x0; x < tile.x1; x += step) {
+			if (row[x] < 0.0f) {
+				glitched_x.push_back(x);
+				glitched_y.push_back(y);
+			}
+		}
+	}
+
+	ReferencePoint local;
+	std::vector<double> real;
+	std::vector<float> values, estimates;
+	for (int round = 0; round < PERTURBATION_MAX_REFERENCES && !glitched_x.empty(); ++round) {
+		std::size_t furthest = 0;
+		for (std::size_t i = 1; i < glitched_x.size(); ++i) {
+			if (target.row(glitched_y[i])[glitched_x[i]] < target.row(glitched_y[furthest])[glitched_x[furthest]]) furthest = i;
+		}
+		double offset_x = view.pixel_offset_x(glitched_x[furthest], key.width);
+		double offset_y = view.pixel_offset_y(glitched_y[furthest], key.height);
+		int bits = view.precision_bits();
+		local.compute(view.center_x + BigFixed(offset_x, view.log_scale, bits),
+			view.center_y + BigFixed(offset_y, view.log_scale, bits), key.iterations);
+		ReferenceOrbit orbit = local.orbit();
+
+		// One block per row of glitched samples
+		std::size_t kept = 0;
+		for (std::size_t first = 0; first < glitched_x.size();) {
+			int y = glitched_y[first];
+			std::size_t last = first;
+			while (last < glitched_x.size() && glitched_y[last] == y) ++last;
+
+			real.resize(last - first);
+			values.resize(last - first);
+			estimates.resize(last - first);
+			for (std::size_t i = first; i < last; ++i) {
+				real[i - first] = std::ldexp(view.pixel_offset_x(glitched_x[i], key.width) - offset_x, view.log_scale);
+			}
+			double imag = std::ldexp(view.pixel_offset_y(y, key.height) - offset_y, view.log_scale);
+			SampleGrid grid = { real.data(), nullptr, static_cast<int>(real.size()), 1, &imag, nullptr, 1, 1, &orbit, nullptr, nullptr,
+				job_estimates ? estimates.data() : nullptr, pixel_spacing(key) };
+			evaluate_block(key.type, PRECISION_PERTURBATION, grid, key.iterations, values.data(), 0);
+
+			for (std::size_t i = first; i < last; ++i) {
+				float value = values[i - first];
+				target.row(y)[glitched_x[i]] = value;
+				if (job_estimates) distance_estimate[static_cast<std::size_t>(y) * target.stride() + glitched_x[i]] = estimates[i - first];
+				if (value < 0.0f) {
+					glitched_x[kept] = glitched_x[i];
+					glitched_y[kept] = y;
+					++kept;
+				}
+			}
+			first = last;
+		}
+		glitched_x.resize(kept);
+		glitched_y.resize(kept);
+	}
+
+	for (std::size_t i = 0; i < glitched_x.size(); ++i) {
+		target.row(glitched_y[i])[glitched_x[i]] = 1.0f;
+		if (job_estimates) distance_estimate[static_cast<std::size_t>(glitched_y[i]) * target.stride() + glitched_x[i]] = 0.0f;
+	}
+}
+
+// Spreads each sample of a coarse pass over its step x step block.
+void Renderer::fill_blocks(FrameBuffer& target, const Tile& tile, int step) {
+	for (int y = tile.y0; y < tile.y1; y += step) {
+		const float* samples = target.row(y);
+		int block_y1 = std::min(y + step, tile.y1);
+		for (int x = tile.x0; x < tile.x1; x += step) {
+			int block_x1 = std::min(x + step, tile.x1);
+			for (int by = y; by < block_y1; ++by) {
+				std::fill(target.row(by) + x, target.row(by) + block_x1, samples[x]);
+			}
+		}
+	}
+}
+
+bool Renderer::interrupted() const {
+	if (frame_budget > 0.0 && std::chrono::steady_clock::now() >= deadline) return true;
+	return interrupt && interrupt();
+}
+
+// Publishes the back buffer. While the job is unfinished the work continues
+// on a copy of what was just shown.
+void Renderer::present() {
+	{
+		std::lock_guard<std::mutex> lock(front_mtx);
+		frame.swap();
+	}
+	has_front = true;
+	front_key = job_key;
+	front_complete = pass_tiles.empty();
+	front_cached = job_cached;
+	front_precision = job_precision;
+	++present_count;
+
+	if (!front_complete) {
+		frame.back() = frame.front();
+	}
+}
+
+void Renderer::read_front(const std::function<void(const FrameBuffer&)>& reader) {
+	std::lock_guard<std::mutex> lock(front_mtx);
+	reader(frame.front());
+}
+
+// True when key is the front frame translated by a whole number of pixels;
+// (dx, dy) is then the pixel offset of the new view within the old one.
+bool Renderer::pan_offset(const RenderKey& key, int& dx, int& dy) const {
+	const RenderKey& old = front_key;
+	if (!has_front || !same_fractal(key, old) || key.iterations != old.iterations ||
+		key.width != old.width || key.height != old.height) return false;
+
+	double span_x = old.view.width(), span_y = old.view.height();
+	if (std::fabs(key.view.width() - span_x) > PAN_SPAN_TOLERANCE * std::fabs(span_x) ||
+		std::fabs(key.view.height() - span_y) > PAN_SPAN_TOLERANCE * std::fabs(span_y)) return false;
+
+	// The centres are subtracted exactly and scaled to the old view, so
+	// this holds at any depth
+	double shift_x = (key.view.center_x - old.view.center_x).scaled(-old.view.log_scale) / old.view.span_x * key.width;
+	double shift_y = (key.view.center_y - old.view.center_y).scaled(-old.view.log_scale) / old.view.span_y * key.height;
+	if (std::fabs(shift_x) >= key.width || std::fabs(shift_y) >= key.height) return false;
+
+	dx = static_cast<int>(std::lround(shift_x));
+	dy = static_cast<int>(std::lround(shift_y));
+	return std::fabs(shift_x - dx) < PAN_PIXEL_TOLERANCE && std::fabs(shift_y - dy) < PAN_PIXEL_TOLERANCE;
+}
+
+// The L-shaped border left uncovered by shift_from(front, dx, dy), as tiles.
+std::vector<Tile> Renderer::exposed_tiles(int dx, int dy) const {
+	int x_begin = std::max(0, -dx), x_end = std::min(width, width - dx);
+	int y_begin = std::max(0, -dy), y_end = std::min(height, height - dy);
+
+	Tile strips[] = {
+		{ 0, 0, width, y_begin },           // rows above the copied block
+		{ 0, y_end, width, height },        // rows below
+		{ 0, y_begin, x_begin, y_end },     // columns left of it
+		{ x_end, y_begin, width, y_end },   // columns right of it
+	};
+
+	std::vector<Tile> work;
+	for (const Tile& strip : strips) {
+		if (strip.x0 >= strip.x1 || strip.y0 >= strip.y1) continue;
+		std::vector<Tile> part = clip_tiles(tiles, strip);
+		work.insert(work.end(), part.begin(), part.end());
+	}
+	return work;
+}
+
+bool Renderer::can_reproject(const RenderKey& key) const {
+	const RenderKey& old = front_key;
+	return has_front && same_fractal(key, old) && key.iterations == old.iterations &&
+		key.width == old.width && key.height == old.height;
+}
+
+// Nearest-neighbour resample of the front frame into the new view as an
+// immediate placeholder. Samples of a finished frame that fall exactly on
+// the new pixel grid (every other pixel after a 2x zoom out) are final,
+// unless they are distance estimates, which are measured in pixels.
+void Renderer::reproject(const RenderKey& key) {
+	const Viewport& old = front_key.view;
+	const Viewport& view = key.view;
+	const FrameBuffer& source = frame.front();
+	FrameBuffer& target = frame.back();
+	bool exact_allowed = front_complete && front_precision == job_precision && !job_estimates;
+	std::vector<int> source_col(width), source_row(height);
+	exact_col.assign(width, -1);
+	exact_row.assign(height, -1);
+	// Positions relative to the old x_min (y_min), in units of its scale
+	double center_x = (view.center_x - old.center_x).scaled(-old.log_scale) + 0.5 * old.span_x;
+	double center_y = (view.center_y - old.center_y).scaled(-old.log_scale) + 0.5 * old.span_y;
+	for (int x = 0; x < width; ++x) {
+		double real = center_x + std::ldexp(view.pixel_offset_x(x, width), view.log_scale - old.log_scale);
+		double u = real / old.span_x * width;
+		long col = std::lround(u);
+		source_col[x] = (col >= 0 && col < width) ? static_cast<int>(col) : -1;
+		if (exact_allowed && source_col[x] >= 0 && std::fabs(u - col) < REPROJECT_EXACT_TOLERANCE) exact_col[x] = source_col[x];
+	}
+	for (int y = 0; y < height; ++y) {
+		double imag = center_y + std::ldexp(view.pixel_offset_y(y, height), view.log_scale - old.log_scale);
+		double v = imag / old.span_y * height;
+		long row = std::lround(v);
+		source_row[y] = (row >= 0 && row < height) ? static_cast<int>(row) : -1;
+		if (exact_allowed && source_row[y] >= 0 && std::fabs(v - row) < REPROJECT_EXACT_TOLERANCE) exact_row[y] = source_row[y];
+	}
+
+	for (int y = 0; y < height; ++y) {
+		float* out = target.row(y);
+		if (source_row[y] < 0) {
+			std::fill(out, out + width, 0.0f);
+			continue;
+		}
+		const float* in = source.row(source_row[y]);
+		for (int x = 0; x < width; ++x) {
+			out[x] = source_col[x] >= 0 ? in[source_col[x]] : 0.0f;
+		}
+	}
+
+	// Tiles with no previous data first, then outwards from the focus
+	std::vector<Tile> uncovered, covered;
+	for (const Tile& tile : tiles) {
+		bool has_data = source_row[tile.y0] >= 0 && source_row[tile.y1 - 1] >= 0 &&
+			source_col[tile.x0] >= 0 && source_col[tile.x1 - 1] >= 0;
+		(has_data ? covered : uncovered).push_back(tile);
+	}
+	prioritize(uncovered);
+	prioritize(covered);
+	job_tiles = uncovered;
+	job_tiles.insert(job_tiles.end(), covered.begin(), covered.end());
+	reuse_exact = exact_allowed;
+}
+
+// Evaluates the pixels of work on a grid of spacing step. Coarse passes
+// fill each step x step block with its corner sample; pixels already
+// sampled by an earlier, coarser pass of the same job are skipped.
+void Renderer::compute_tiles(const RenderKey& key, FrameBuffer& target, std::vector<Tile>& work, int step, bool interruptible) {
+	int coarser = step < first_step ? 2 * step : 0;
+
+	// Small Morton-ordered tiles on per-worker deques; idle workers steal,
+	// so cheap and expensive regions even out whatever the fractal.
+	scheduler.reset(work);
+
+	// Hoist the per-column and per-row divides out of the tile loops. The
+	// double-double tier maps the full viewport and keeps the low parts,
+	// perturbation takes offsets from the centre (exact at any depth) and
+	// the others map the viewport's nearest doubles.
+	column_real.resize(width);
+	row_imag.resize(height);
+	if (job_precision == PRECISION_PERTURBATION) {
+		const Viewport& view = key.view;
+		for (int x = 0; x < width; ++x) {
+			column_real[x] = std::ldexp(view.pixel_offset_x(x, key.width), view.log_scale);
+		}
+		for (int y = 0; y < height; ++y) {
+			row_imag[y] = std::ldexp(view.pixel_offset_y(y, key.height), view.log_scale);
+		}
+		if (!reference_ready) {
+			reference.compute(view.center_x, view.center_y, key.iterations);
+			reference_orbit = reference.orbit();
+			reference_ready = true;
+		}
+	}
+	else if (job_precision == PRECISION_DOUBLE_DOUBLE) {
+		CoordinateViewport view = key.view.bounds<Coordinate>();
+		column_real_lo.resize(width);
+		for (int x = 0; x < width; ++x) {
+			Coordinate real = pixel_coordinate(view.x_min, view.x_max, x, key.width);
+			column_real[x] = real.hi;
+			column_real_lo[x] = real.lo;
+		}
+		row_imag_lo.resize(height);
+		for (int y = 0; y < height; ++y) {
+			Coordinate imag = pixel_coordinate(view.y_min, view.y_max, y, key.height);
+			row_imag[y] = imag.hi;
+			row_imag_lo[y] = imag.lo;
+		}
+	}
+	else {
+		DoubleViewport view = key.view.bounds<double>();
+		for (int x = 0; x < width; ++x) {
+			column_real[x] = pixel_coordinate(view.x_min, view.x_max, x, key.width);
+		}
+		for (int y = 0; y < height; ++y) {
+			row_imag[y] = pixel_coordinate(view.y_min, view.y_max, y, key.height);
+		}
+	}
+
+	// Boxes of c only hold a tile in the tiers whose samples are plain
+	// doubles (or floats) of the coordinates
+	bool classify = tile_classification && key.type == MANDELBROT &&
+		(job_precision == PRECISION_FLOAT || job_precision == PRECISION_DOUBLE);
+
+	pool.run([&](int worker) {
+		Tile tile;
+		while (!(interruptible && interrupted()) && scheduler.next(worker, tile)) {
+			// Each tile belongs to exactly one worker, no lock needed
+			if (job_keeps_state && !job_resumes && step == first_step) clear_escape_state(tile);
+			if (reuse_exact) {
+				compute_rows(key, target, tile, step);
+			}
+			else if (classify) {
+				float value = classify_box(key, tile, step);
+				if (value != MANDELBROT_BOX_MIXED) fill_samples(target, tile, step, value);
+				else classify_area(key, target, tile, step, coarser);
+			}
+			else {
+				compute_area(key, target, tile, step, coarser);
+			}
+			if (job_precision == PRECISION_PERTURBATION) resolve_glitches(key, target, tile, step);
+			if (step > 1) fill_blocks(target, tile, step);
+		}
+		});
+
+	work = scheduler.drain();
+}
+
+// The samples of area at spacing step that the coarser pass (if any) did
+// not take.
+void Renderer::compute_area(const RenderKey& key, FrameBuffer& target, const Tile& area, int step, int coarser) {
+	if (key.subdivide) {
+		// Filled samples were never evaluated, so nothing is taken over
+		// from the coarser pass
+		subdivide(key, target, area, step);
+	}
+	else if (coarser) {
+		// The coarser pass took every other sample of every other row
+		int x_odd = area.x0 % coarser == 0 ? area.x0 + step : area.x0;
+		int y_even = area.y0 % coarser == 0 ? area.y0 : area.y0 + step;
+		compute_grid(key, target, area, x_odd, coarser, y_even, coarser);
+		compute_grid(key, target, area, area.x0, step, y_even == area.y0 ? area.y0 + step : area.y0, coarser);
+	}
+	else {
+		compute_grid(key, target, area, area.x0, step, area.y0, step);
+	}
+}
+
+// mandelbrot_box over the samples of area at spacing step
+float Renderer::classify_box(const RenderKey& key, const Tile& area, int step) const {
+	int x1 = area.x0 + (area.x1 - 1 - area.x0) / step * step; // last sample column and row
+	int y1 = area.y0 + (area.y1 - 1 - area.y0) / step * step;
+	double real_lo = std::min(column_real[area.x0], column_real[x1]), real_hi = std::max(column_real[area.x0], column_real[x1]);
+	double imag_lo = std::min(row_imag[area.y0], row_imag[y1]), imag_hi = std::max(row_imag[area.y0], row_imag[y1]);
+	double margin = CLASSIFY_MARGIN_DOUBLE;
+	if (job_precision == PRECISION_FLOAT) {
+		// The float kernels iterate the samples rounded to float, and
+		// rounding keeps them between the rounded corners
+		real_lo = static_cast<float>(real_lo);
+		real_hi = static_cast<float>(real_hi);
+		imag_lo = static_cast<float>(imag_lo);
+		imag_hi = static_cast<float>(imag_hi);
+		margin = CLASSIFY_MARGIN_FLOAT;
+	}
+	float value = mandelbrot_box(real_lo, real_hi, imag_lo, imag_hi, key.iterations, margin);
+	// Samples that escape on the same iteration still differ in distance
+	if (job_estimates && value != 1.0f) return MANDELBROT_BOX_MIXED;
+	return value;
+}
+
+void Renderer::fill_samples(FrameBuffer& target, const Tile& area, int step, float value) {
+	for (int y = area.y0; y < area.y1; y += step) {
+		float* row = target.row(y);
+		for (int x = area.x0; x < area.x1; x += step) row[x] = value;
+	}
+}
+
+// Evaluates area, which classify_box could not fill, or as much of it as
+// its quarters cannot. Quarters are classified in turn down to
+// CLASSIFY_MIN_SAMPLES across; if none of them can be filled the area is
+// evaluated whole, which keeps the kernel's lanes busier than four small
+// blocks would.
+void Renderer::classify_area(const RenderKey& key, FrameBuffer& target, const Tile& area, int step, int coarser) {
+	int columns = (area.x1 - area.x0 + step - 1) / step, rows = (area.y1 - area.y0 + step - 1) / step;
+	if (columns < 2 * CLASSIFY_MIN_SAMPLES && rows < 2 * CLASSIFY_MIN_SAMPLES) {
+		compute_area(key, target, area, step, coarser);
+		return;
+	}
+
+	int x_middle = area.x0 + (columns + 1) / 2 * step, y_middle = area.y0 + (rows + 1) / 2 * step;
+	Tile quarters[] = {
+		{ area.x0, area.y0, x_middle, y_middle }, { x_middle, area.y0, area.x1, y_middle },
+		{ area.x0, y_middle, x_middle, area.y1 }, { x_middle, y_middle, area.x1, area.y1 },
+	};
+	float values[4];
+	bool filled = false;
+	for (int q = 0; q < 4; ++q) {
+		const Tile& quarter = quarters[q];
+		values[q] = quarter.x0 < quarter.x1 && quarter.y0 < quarter.y1 ? classify_box(key, quarter, step) : 0.0f;
+		filled = filled || values[q] != MANDELBROT_BOX_MIXED;
+	}
+	if (!filled) {
+		compute_area(key, target, area, step, coarser);
+		return;
+	}
+	for (int q = 0; q < 4; ++q) {
+		const Tile& quarter = quarters[q];
+		if (quarter.x0 >= quarter.x1 || quarter.y0 >= quarter.y1) continue;
+		if (values[q] == MANDELBROT_BOX_MIXED) classify_area(key, target, quarter, step, coarser);
+		else fill_samples(target, quarter, step, values[q]);
+	}
+}
+
+// Mariani-Silver over the samples of tile: its border, then the inside.
+void Renderer::subdivide(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step) {
+	int x1 = tile.x0 + (tile.x1 - 1 - tile.x0) / step * step; // last sample column and row
+	int y1 = tile.y0 + (tile.y1 - 1 - tile.y0) / step * step;
+	// Top and bottom rows, then the first and last columns between them
+	compute_grid(key, target, tile, tile.x0, step, tile.y0, std::max(y1 - tile.y0, step));
+	if (y1 - tile.y0 > step) {
+		Tile sides = { tile.x0, tile.y0 + step, tile.x1, y1 };
+		compute_grid(key, target, sides, tile.x0, std::max(x1 - tile.x0, step), sides.y0, step);
+	}
+	subdivide_inside(key, target, tile.x0, tile.y0, x1, y1, step);
+}
+
+// The samples strictly inside the rectangle with corner samples (x0, y0)
+// and (x1, y1), whose border samples are already computed. A border that
+// changes value all along it is not worth splitting further.
+void Renderer::subdivide_inside(const RenderKey& key, FrameBuffer& target, int x0, int y0, int x1, int y1, int step) {
+	if (x1 - x0 < 2 * step || y1 - y0 < 2 * step) return;
+
+	float value = target.row(y0)[x0];
+	int changes = 0, border = 0; // border samples off the corner value, of all
+	for (int x = x0; x <= x1; x += step) {
+		changes += (target.row(y0)[x] != value) + (target.row(y1)[x] != value);
+		border += 2;
+	}
+	for (int y = y0 + step; y < y1; y += step) {
+		changes += (target.row(y)[x0] != value) + (target.row(y)[x1] != value);
+		border += 2;
+	}
+	// A border far from the boundary of a fractal with distance estimates
+	// is only filled over if it proves the inside far too: every inside
+	// sample lies within half the shorter side, and half a step along the
+	// border, of a border sample, which the set is at least its estimate
+	// away from.
+	double reach = 0.5 * (std::min(x1 - x0, y1 - y0) + step);
+	if (!changes && (!job_estimates || value != 0.0f || border_distance(target, x0, y0, x1, y1, step) >= DISTANCE_FALLOFF + reach)) {
+		for (int y = y0 + step; y < y1; y += step) {
+			float* row = target.row(y);
+			for (int x = x0 + step; x < x1; x += step) row[x] = value;
+		}
+		return;
+	}
+
+	Tile inside = { x0 + step, y0 + step, x1, y1 };
+	int columns = (x1 - x0) / step, rows = (y1 - y0) / step;
+	if ((columns < SUBDIVIDE_MIN_SAMPLES && rows < SUBDIVIDE_MIN_SAMPLES) || changes * SUBDIVIDE_BUSY_BORDER > border) {
+		compute_grid(key, target, inside, inside.x0, step, inside.y0, step);
+		return;
+	}
+
+	// Split across the longer side; the dividing line is the new border
+	if (columns >= rows) {
+		int middle = x0 + columns / 2 * step;
+		compute_grid(key, target, inside, middle, x1 - x0, inside.y0, step);
+		subdivide_inside(key, target, x0, y0, middle, y1, step);
+		subdivide_inside(key, target, middle, y0, x1, y1, step);
+	}
+	else {
+		int middle = y0 + rows / 2 * step;
+		compute_grid(key, target, inside, inside.x0, step, middle, y1 - y0);
+		subdivide_inside(key, target, x0, y0, x1, middle, step);
+		subdivide_inside(key, target, x0, middle, x1, y1, step);
+	}
+}
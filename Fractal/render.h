@@ -0,0 +1,241 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "fractal.h"
+#include "framebuffer.h"
+#include "frame_cache.h"
+#include "math.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
+
+#define PIXEL_FRACTAL_DEPTH 6 // recursion depth used by the point-in-fractal tests
+#define PROGRESSIVE_START_STEP 8 // first progressive pass takes one sample per 8x8 block
+#define CLASSIFY_MIN_SAMPLES 8 // interval classification splits areas down to this many samples across
+#define SUBDIVIDE_MIN_SAMPLES 6 // subdivided rectangles with fewer samples across are evaluated in full
+#define SUBDIVIDE_BUSY_BORDER 2 // ... as are those with over 1/2 of their border off the corner value
+
+// Fractals rendered on the CPU into a scalar field (as opposed to line
+// fractals and the GPU Mandelbrot).
+bool is_pixel_fractal(FractalType type);
+
+// Fractals iterated until |z| escapes (the Mandelbrot set and its family),
+// which the CPU renders in every precision tier.
+bool is_escape_time(FractalType type);
+
+// Fractals that can show distance estimates (RenderKey::distance; see
+// mandelbrot_distance): those whose step is analytic, so the derivative of
+// the orbit by the sample is a complex number.
+bool has_distance_estimate(FractalType type);
+
+// Keys whose jobs keep the escape-time state of every pixel in the given
+// precision, so that changing only the iteration cap carries on from it.
+// Distance estimates are not kept, so they start over.
+bool keeps_escape_state(const RenderKey& key, Precision precision);
+
+// Iteration count a fractal actually uses for a requested count; pixel
+// fractals always run at PIXEL_FRACTAL_DEPTH.
+int fractal_iterations(FractalType type, int requested);
+
+// Arithmetic the escape-time kernels run in for key: key.precision, or
+// for PRECISION_AUTO the cheapest tier whose pixel spacing, relative to the
+// size of the coordinates, still resolves every pixel (float while the
+// spacing is above 2^-16 of it, double above 2^-44, else perturbation for
+// the Mandelbrot set and double-double for anything else). Perturbation,
+// even when forced, is Mandelbrot-only; other types take double-double.
+// Distance estimates take double for float. Pixel fractals always report
+// PRECISION_DOUBLE.
+Precision resolve_precision(const RenderKey& key);
+const char* precision_name(Precision precision);
+
+// Per-frame compute budget in milliseconds from "--frame-budget MS" on the
+// command line or the FRACTAL_FRAME_BUDGET environment variable; 0 if unset.
+double resolve_frame_budget(int argc, char* argv[]);
+
+// CPU renderer for pixel fractals: worker pool, tile scheduler, double
+// buffered output and a cache of recent frames. A view that is the front
+// frame moved by whole pixels reuses the overlap and only computes the
+// newly exposed strips. Any other change of view of the same fractal
+// (zoom) first presents the previous frame resampled into the new view,
+// then refines it tile by tile on the following calls. In progressive mode
+// a full recompute is shown as it converges: one sample per 8x8 block,
+// then 4x4, 2x2 and 1x1, each pass reusing the samples already taken.
+//
+// Mandelbrot tiles in the float and double tiers are first classified in
+// interval arithmetic (see mandelbrot_box): a tile proven to escape on one
+// iteration, or proven interior, is filled without evaluating a pixel,
+// and one that is not is split into quarters that are tried in turn. The
+// proof is rigorous, so unlike subdivision this cannot change the picture.
+//
+// Jobs that keep escape-time state (see keeps_escape_state) leave every
+// pixel's orbit in a side buffer. A later key that differs from it only in
+// the iteration cap resumes the orbits still running below the new cap and
+// recolours the rest, starting from the old picture.
+//
+// With key.subdivide each tile is rendered Mariani-Silver style: only the
+// border of a rectangle is evaluated, and if it is all one value the
+// inside is filled with it; otherwise the rectangle is split in two and
+// each half goes the same way, until it is small or its border busy
+// enough that evaluating everything is cheaper. Every pass does this on
+// its own sample grid. It is not exact: detail that sits wholly inside a
+// single-valued border, such as a filament passing between its samples,
+// is filled over, so callers leave it off unless asked. With distance
+// estimates a border that is all far from the boundary is only filled
+// when the estimates along it prove every sample inside far too.
+//
+// Work is ordered by distance from a focus point (the frame centre unless
+// set), so the region the user is looking at converges first.
+//
+// With a frame budget each render() call stops taking tiles once the budget
+// is spent and presents what it has: tiles the current pass has not reached
+// still show the previous, coarser pass. The next call carries on.
+//
+// render() is meant to be driven from a single thread (see RenderService);
+// read_front() may be called from any thread.
+class Renderer {
+public:
+	Renderer(int width, int height, int thread_count);
+
+	// Advances the job for key by one step (a placeholder or one pass) and
+	// presents the result. Returns true when the front buffer changed and
+	// must be uploaded again. Call again while finished() is false.
+	bool render(const RenderKey& key);
+
+	// The job for the last key passed to render() has run to completion.
+	bool finished() const { return has_job && pass_tiles.empty(); }
+
+	// Interval classification of Mandelbrot tiles (on by default)
+	void set_tile_classification(bool enabled) { tile_classification = enabled; }
+	bool is_tile_classification() const { return tile_classification; }
+
+	void set_progressive(bool enabled) { progressive = enabled; }
+	bool is_progressive() const { return progressive; }
+
+	// Compute budget per render() call in milliseconds, 0 for unbounded.
+	// A budget implies progressive passes, so there is always a coarser
+	// pass to fall back on.
+	void set_frame_budget(double milliseconds) { frame_budget = milliseconds; }
+	double get_frame_budget() const { return frame_budget; }
+
+	// Polled between tiles; when it returns true workers stop taking tiles
+	// and render() returns with the pass unfinished. The tiles left over are
+	// picked up by the next render() call for the same key.
+	void set_interrupt(const std::function<bool()>& check) { interrupt = check; }
+
+	// Pixel (x, y) of the frame (row 0 is y_min) whose surroundings are
+	// computed first. Moving it mid-job reorders the tiles still to do.
+	void set_focus(double x, double y);
+	void clear_focus() { set_focus(0.5 * width, 0.5 * height); }
+
+	// Precision the last job started runs in (see resolve_precision).
+	Precision precision() const { return used_precision; }
+
+	// Always recomputes key into the front buffer, bypassing the cache and
+	// the interrupt.
+	void compute_fractal(const RenderKey& key);
+
+	// Calls reader with the front buffer; presenting waits until it returns.
+	void read_front(const std::function<void(const FrameBuffer&)>& reader);
+	const FrameBuffer& front() { return frame.front(); }
+	unsigned presented() const { return present_count; }
+	int thread_count() const { return pool.size(); }
+
+private:
+	bool begin(const RenderKey& key);
+	void run_pass(const RenderKey& key);
+	bool pan_offset(const RenderKey& key, int& dx, int& dy) const;
+	std::vector<Tile> exposed_tiles(int dx, int dy) const;
+	bool can_reproject(const RenderKey& key) const;
+	void reproject(const RenderKey& key);
+	void compute_tiles(const RenderKey& key, FrameBuffer& target, std::vector<Tile>& work, int step, bool interruptible);
+	void start_escape_state(const RenderKey& key, int dx, int dy, bool pan);
+	void clear_escape_state(const Tile& tile);
+	void compute_area(const RenderKey& key, FrameBuffer& target, const Tile& area, int step, int coarser);
+	float classify_box(const RenderKey& key, const Tile& area, int step) const;
+	void classify_area(const RenderKey& key, FrameBuffer& target, const Tile& area, int step, int coarser);
+	void fill_samples(FrameBuffer& target, const Tile& area, int step, float value);
+	void subdivide(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step);
+	void subdivide_inside(const RenderKey& key, FrameBuffer& target, int x0, int y0, int x1, int y1, int step);
+	float border_distance(const FrameBuffer& target, int x0, int y0, int x1, int y1, int step) const;
+	void compute_grid(const RenderKey& key, FrameBuffer& target, const Tile& tile, int x0, int step_x, int y0, int step_y);
+	void compute_rows(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step);
+	void compute_samples(const RenderKey& key, FrameBuffer& target, int x0, int columns, int step_x, int y0, int rows, int step_y);
+	void resolve_glitches(const RenderKey& key, FrameBuffer& target, const Tile& tile, int step);
+	void fill_blocks(FrameBuffer& target, const Tile& tile, int step);
+	bool interrupted() const;
+	void prioritize(std::vector<Tile>& work) const { sort_by_distance(work, focus_x, focus_y); }
+	void present();
+
+	int width, height;
+	ThreadPool pool;
+	TileScheduler scheduler;
+	std::vector<Tile> tiles;
+	DoubleBuffer frame;
+	FrameCache cache;
+	std::function<bool()> interrupt;
+	double frame_budget = 0.0;
+	double focus_x, focus_y;
+	std::chrono::steady_clock::time_point deadline;
+	std::mutex front_mtx;
+	std::atomic<unsigned> present_count;
+	std::atomic<Precision> used_precision;
+
+	// What the front buffer shows
+	bool has_front = false;
+	RenderKey front_key;
+	bool front_complete = false; // every pixel final for front_key
+	bool front_cached = false;   // already stored in the cache
+	Precision front_precision = PRECISION_DOUBLE;
+
+	// What is being computed into the back buffer. Every pass covers
+	// job_tiles at a sample spacing of pass_step; pass_tiles are the tiles
+	// the current pass has not reached yet.
+	bool has_job = false;
+	RenderKey job_key;
+	Precision job_precision = PRECISION_DOUBLE;
+	std::vector<Tile> job_tiles;
+	std::vector<Tile> pass_tiles;
+	int pass_step = 1;
+	int first_step = 1;
+	bool job_presentable = false; // back buffer holds a whole picture of job_key
+	bool job_cached = false;
+	bool progressive = true;
+	bool tile_classification = true;
+
+	// Distance estimates in pixels of the samples of the job, laid out like
+	// the frame, when it estimates distances. Only those a tile has
+	// evaluated in the current pass are read back, by subdivide_inside.
+	std::vector<float> distance_estimate;
+	bool job_estimates = false;
+
+	// Escape-time state of every pixel, laid out like the frame, for the
+	// view of state_key at any cap. Jobs that keep it and do not resume it
+	// clear each tile in their first pass, which leaves it whole.
+	std::vector<EscapeState> escape_state;
+	RenderKey state_key;
+	Precision state_precision = PRECISION_DOUBLE;
+	bool state_whole = false; // every pixel's state belongs to state_key
+	bool job_keeps_state = false;
+	bool job_resumes = false;
+
+	// Reprojection: column/row of the previous frame whose samples land
+	// exactly on this column/row (-1 if none); such pixels are not recomputed
+	std::vector<int> exact_col, exact_row;
+	bool reuse_exact = false;
+
+	// Real part of each column and imaginary part of each row for the pass,
+	// and their low parts when it runs in double-double. With perturbation
+	// they are offsets from the view centre, whose orbit is the reference.
+	std::vector<double> column_real, row_imag;
+	std::vector<double> column_real_lo, row_imag_lo;
+	ReferencePoint reference;
+	ReferenceOrbit reference_orbit;
+	bool reference_ready = false; // reference holds the orbit of job_key's centre
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "render_service.h"
+
+RenderService::RenderService(int width, int height, int thread_count)
+	: renderer(width, height, thread_count), progressive(renderer.is_progressive()),
+	tile_classification(renderer.is_tile_classification()), frame_budget(renderer.get_frame_budget()), generation(0) {
+	thread = std::thread(&RenderService::loop, this);
+}
+
+RenderService::~RenderService() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+		++generation;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void RenderService::post(const RenderKey& key) {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (has_latest && latest == key) return;
+		latest = key;
+		has_latest = true;
+		++generation;
+	}
+	wake.notify_one();
+}
+
+void RenderService::set_focus(double x, double y) {
+	std::lock_guard<std::mutex> lock(mtx);
+	focus_x = x;
+	focus_y = y;
+}
+
+void RenderService::set_progressive(bool enabled) {
+	std::lock_guard<std::mutex> lock(mtx);
+	progressive = enabled;
+}
+
+bool RenderService::is_progressive() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return progressive;
+}
+
+void RenderService::set_tile_classification(bool enabled) {
+	std::lock_guard<std::mutex> lock(mtx);
+	tile_classification = enabled;
+}
+
+bool RenderService::is_tile_classification() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return tile_classification;
+}
+
+void RenderService::set_frame_budget(double milliseconds) {
+	std::lock_guard<std::mutex> lock(mtx);
+	frame_budget = milliseconds;
+}
+
+double RenderService::get_frame_budget() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return frame_budget;
+}
+
+bool RenderService::fetch(const std::function<void(const FrameBuffer&)>& upload, bool force) {
+	unsigned count = renderer.presented();
+	if (count == 0 || (!force && count == fetched)) return false;
+	fetched = count;
+	renderer.read_front(upload);
+	return true;
+}
+
+void RenderService::with_renderer(const std::function<void(Renderer&)>& f) {
+	{
+		// Interrupts the step in flight and holds off the next one
+		std::lock_guard<std::mutex> lock(mtx);
+		++borrowers;
+		++generation;
+	}
+	{
+		std::lock_guard<std::mutex> lock(renderer_mtx);
+		f(renderer);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		--borrowers;
+	}
+	wake.notify_one();
+}
+
+void RenderService::loop() {
+	unsigned seen = 0;
+	bool idle = true;
+
+	for (;;) {
+		RenderKey key;
+		double x, y, budget;
+		bool passes, classify;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			wake.wait(lock, [&]() { return stopping || (borrowers == 0 && has_latest && (!idle || generation != seen)); });
+			if (stopping) return;
+			key = latest;
+			seen = generation;
+			x = focus_x;
+			y = focus_y;
+			passes = progressive;
+			classify = tile_classification;
+			budget = frame_budget;
+		}
+
+		std::lock_guard<std::mutex> lock(renderer_mtx);
+		// Stop taking tiles as soon as a newer view (or shutdown) is posted
+		renderer.set_interrupt([this, seen]() { return generation.load() != seen; });
+		if (x < 0.0 || y < 0.0) renderer.clear_focus();
+		else renderer.set_focus(x, y);
+		renderer.set_progressive(passes);
+		renderer.set_tile_classification(classify);
+		renderer.set_frame_budget(budget);
+		renderer.render(key);
+		idle = renderer.finished();
+	}
+}
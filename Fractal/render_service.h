@@ -0,0 +1,75 @@
+#ifndef RENDER_SERVICE_H
+#define RENDER_SERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "render.h"
+
+// Runs a Renderer on its own thread so compute never blocks the SDL event
+// loop. The UI posts the latest view; work still in flight for a view that
+// has been superseded is cancelled between tiles, and the UI only uploads
+// the newest presented (complete or partial) frame.
+class RenderService {
+public:
+	RenderService(int width, int height, int thread_count);
+	~RenderService();
+
+	RenderService(const RenderService&) = delete;
+	RenderService& operator=(const RenderService&) = delete;
+
+	// Makes key the view to render; cheap to call every frame.
+	void post(const RenderKey& key);
+
+	// Pixel to prioritise (see Renderer::set_focus); applied before the
+	// next render step.
+	void set_focus(double x, double y);
+
+	// Renderer settings, applied before the next render step like the
+	// focus, so changing them never waits for the step in flight.
+	void set_progressive(bool enabled);
+	bool is_progressive() const;
+	void set_tile_classification(bool enabled);
+	bool is_tile_classification() const;
+	void set_frame_budget(double milliseconds);
+	double get_frame_budget() const;
+
+	// Calls upload with the front buffer if a frame was presented since the
+	// last fetch (or always, with force). Returns true if upload was called.
+	bool fetch(const std::function<void(const FrameBuffer&)>& upload, bool force = false);
+
+	// Runs f on the renderer while the render thread is between steps.
+	// The step in flight is cancelled first, but one that cannot be
+	// interrupted (a first pass) is waited for, so this can block.
+	void with_renderer(const std::function<void(Renderer&)>& f);
+
+	int thread_count() const { return renderer.thread_count(); }
+
+	// Precision of the view being rendered (see Renderer::precision).
+	Precision precision() const { return renderer.precision(); }
+
+private:
+	void loop();
+
+	Renderer renderer;
+	std::mutex renderer_mtx; // held by the render thread while it works
+
+	mutable std::mutex mtx;
+	std::condition_variable wake;
+	RenderKey latest;
+	bool has_latest = false;
+	double focus_x = -1.0, focus_y = -1.0; // negative: frame centre
+	bool progressive, tile_classification;
+	double frame_budget;
+	bool stopping = false;
+	int borrowers = 0; // with_renderer calls waiting for or holding the renderer
+	std::atomic<unsigned> generation;
+	unsigned fetched = 0;
+
+	std::thread thread;
+};
+
+#endif
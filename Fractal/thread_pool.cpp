@@ -0,0 +1,70 @@
+#include "thread_pool.h"
+
+#include <cstdlib>
+#include <cstring>
+
+ThreadPool::ThreadPool(int thread_count) {
+	if (thread_count <= 0) {
+		thread_count = static_cast<int>(std::thread::hardware_concurrency());
+		if (thread_count <= 0) thread_count = 1;
+	}
+	workers.reserve(thread_count);
+	for (int i = 0; i < thread_count; ++i) {
+		workers.emplace_back(&ThreadPool::worker_loop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(const std::function<void(int)>& job) {
+	std::lock_guard<std::mutex> serial(run_mtx);
+	std::unique_lock<std::mutex> lock(mtx);
+	current_job = &job;
+	pending = size();
+	++generation;
+	wake.notify_all();
+	finished.wait(lock, [this]() { return pending == 0; });
+	current_job = nullptr;
+}
+
+void ThreadPool::worker_loop(int index) {
+	unsigned seen = 0;
+	for (;;) {
+		const std::function<void(int)>* job;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			wake.wait(lock, [&]() { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+			job = current_job;
+		}
+
+		(*job)(index);
+
+		std::lock_guard<std::mutex> lock(mtx);
+		if (--pending == 0) finished.notify_one();
+	}
+}
+
+int resolve_thread_count(int argc, char* argv[]) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::strcmp(argv[i], "--threads") == 0) {
+			int count = std::atoi(argv[i + 1]);
+			if (count > 0) return count;
+		}
+	}
+	if (const char* env = std::getenv("FRACTAL_THREADS")) {
+		int count = std::atoi(env);
+		if (count > 0) return count;
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Long-lived worker threads, started once and fed render jobs.
+// A job is broadcast to every worker; workers pull their own share of the
+// work (rows, tiles, ...) from whatever queue the job closes over.
+class ThreadPool {
+public:
+	// thread_count <= 0 picks std::thread::hardware_concurrency()
+	explicit ThreadPool(int thread_count = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const { return static_cast<int>(workers.size()); }
+
+	// Runs job(worker_index) on every worker and blocks until all of them return.
+	void run(const std::function<void(int)>& job);
+
+private:
+	void worker_loop(int index);
+
+	std::vector<std::thread> workers;
+	std::mutex run_mtx; // one job in flight at a time
+	std::mutex mtx;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	const std::function<void(int)>* current_job = nullptr;
+	unsigned generation = 0;
+	int pending = 0;
+	bool stopping = false;
+};
+
+// Worker count from "--threads N" on the command line, then the
+// FRACTAL_THREADS environment variable, then the hardware core count.
+int resolve_thread_count(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,133 @@
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Interleaves the bits of x and y (x in the even bits).
+static std::uint32_t morton_code(std::uint32_t x, std::uint32_t y) {
+	std::uint32_t code = 0;
+	for (int bit = 0; bit < 16; ++bit) {
+		code |= ((x >> bit) & 1u) << (2 * bit);
+		code |= ((y >> bit) & 1u) << (2 * bit + 1);
+	}
+	return code;
+}
+
+std::vector<Tile> make_tiles(int width, int height, int tile_size) {
+	int cols = (width + tile_size - 1) / tile_size;
+	int rows = (height + tile_size - 1) / tile_size;
+
+	std::vector<std::pair<std::uint32_t, Tile>> keyed;
+	keyed.reserve(static_cast<size_t>(cols) * rows);
+	for (int ty = 0; ty < rows; ++ty) {
+		for (int tx = 0; tx < cols; ++tx) {
+			Tile tile;
+			tile.x0 = tx * tile_size;
+			tile.y0 = ty * tile_size;
+			tile.x1 = std::min(tile.x0 + tile_size, width);
+			tile.y1 = std::min(tile.y0 + tile_size, height);
+			keyed.emplace_back(morton_code(tx, ty), tile);
+		}
+	}
+	std::sort(keyed.begin(), keyed.end(),
+		[](const std::pair<std::uint32_t, Tile>& a, const std::pair<std::uint32_t, Tile>& b) { return a.first < b.first; });
+
+	std::vector<Tile> tiles;
+	tiles.reserve(keyed.size());
+	for (const auto& entry : keyed) {
+		tiles.push_back(entry.second);
+	}
+	return tiles;
+}
+
+std::vector<Tile> clip_tiles(const std::vector<Tile>& tiles, const Tile& region) {
+	std::vector<Tile> clipped;
+	for (const Tile& tile : tiles) {
+		Tile part;
+		part.x0 = std::max(tile.x0, region.x0);
+		part.y0 = std::max(tile.y0, region.y0);
+		part.x1 = std::min(tile.x1, region.x1);
+		part.y1 = std::min(tile.y1, region.y1);
+		if (part.x0 < part.x1 && part.y0 < part.y1) {
+			clipped.push_back(part);
+		}
+	}
+	return clipped;
+}
+
+void sort_by_distance(std::vector<Tile>& tiles, double x, double y) {
+	auto distance = [x, y](const Tile& tile) {
+		double dx = 0.5 * (tile.x0 + tile.x1) - x;
+		double dy = 0.5 * (tile.y0 + tile.y1) - y;
+		return dx * dx + dy * dy;
+	};
+	std::stable_sort(tiles.begin(), tiles.end(),
+		[&](const Tile& a, const Tile& b) { return distance(a) < distance(b); });
+}
+
+TileScheduler::TileScheduler(int worker_count) {
+	if (worker_count < 1) worker_count = 1;
+	for (int i = 0; i < worker_count; ++i) {
+		queues.emplace_back(new Queue());
+	}
+}
+
+void TileScheduler::reset(const std::vector<Tile>& tiles) {
+	size_t workers = queues.size();
+	for (size_t w = 0; w < workers; ++w) {
+		std::lock_guard<std::mutex> lock(queues[w]->mtx);
+		queues[w]->tiles.clear();
+		for (size_t i = w; i < tiles.size(); i += workers) {
+			queues[w]->tiles.push_back(tiles[i]);
+		}
+	}
+}
+
+bool TileScheduler::next(int worker, Tile& tile) {
+	Queue& own = *queues[worker];
+	{
+		std::lock_guard<std::mutex> lock(own.mtx);
+		if (!own.tiles.empty()) {
+			tile = own.tiles.front();
+			own.tiles.pop_front();
+			return true;
+		}
+	}
+	return steal(worker, tile);
+}
+
+std::vector<Tile> TileScheduler::drain() {
+	std::vector<std::deque<Tile>> remaining;
+	for (auto& queue : queues) {
+		std::lock_guard<std::mutex> lock(queue->mtx);
+		remaining.push_back(std::move(queue->tiles));
+		queue->tiles.clear();
+	}
+
+	// Re-interleave the deques to undo the round-robin deal
+	std::vector<Tile> left;
+	for (bool any = true; any;) {
+		any = false;
+		for (auto& tiles : remaining) {
+			if (tiles.empty()) continue;
+			left.push_back(tiles.front());
+			tiles.pop_front();
+			any = true;
+		}
+	}
+	return left;
+}
+
+bool TileScheduler::steal(int thief, Tile& tile) {
+	int workers = worker_count();
+	for (int offset = 1; offset < workers; ++offset) {
+		Queue& victim = *queues[(thief + offset) % workers];
+		std::lock_guard<std::mutex> lock(victim.mtx);
+		if (!victim.tiles.empty()) {
+			tile = victim.tiles.back();
+			victim.tiles.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
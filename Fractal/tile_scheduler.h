@@ -0,0 +1,59 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define TILE_SIZE 32
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct Tile {
+	int x0, y0;
+	int x1, y1;
+};
+
+// Cuts a width x height frame into tile_size squares (edge tiles are
+// clipped) and returns them in Morton (Z-order) order, so neighbouring
+// tiles in the list are neighbours on screen.
+std::vector<Tile> make_tiles(int width, int height, int tile_size = TILE_SIZE);
+
+// The parts of tiles that overlap region, in the same order.
+std::vector<Tile> clip_tiles(const std::vector<Tile>& tiles, const Tile& region);
+
+// Stable sort of tiles by the distance of their centre from pixel (x, y).
+void sort_by_distance(std::vector<Tile>& tiles, double x, double y);
+
+// Per-worker tile deques with work stealing. Each worker pops from the front
+// of its own deque; when that runs dry it steals from the back of another
+// worker's deque, so expensive regions do not leave the others idle.
+class TileScheduler {
+public:
+	explicit TileScheduler(int worker_count);
+
+	int worker_count() const { return static_cast<int>(queues.size()); }
+
+	// Deals the tiles out round-robin, so every worker starts near the head
+	// of the list: a priority-ordered list is roughly completed in order,
+	// and consecutive Morton tiles keep the workers on neighbouring pixels.
+	void reset(const std::vector<Tile>& tiles);
+
+	// Next tile for this worker; false once every deque is empty.
+	bool next(int worker, Tile& tile);
+
+	// Empties every deque and returns the tiles nobody took, in deal order.
+	std::vector<Tile> drain();
+
+private:
+	struct Queue {
+		std::mutex mtx;
+		std::deque<Tile> tiles;
+	};
+
+	bool steal(int thief, Tile& tile);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+};
+
+#endif
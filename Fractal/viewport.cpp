@@ -0,0 +1,46 @@
+#include "viewport.h"
+
+#include <algorithm>
+
+Viewport::Viewport(double x_min, double x_max, double y_min, double y_max, double zoom)
+	: span_x(x_max - x_min), span_y(y_max - y_min), zoom(zoom) {
+	normalize();
+	int bits = precision_bits() + 64;
+	BigFixed half(0.5, bits);
+	center_x = (BigFixed(x_min, bits) + BigFixed(x_max, bits)) * half;
+	center_y = (BigFixed(y_min, bits) + BigFixed(y_max, bits)) * half;
+	normalize();
+}
+
+void Viewport::zoom_at(double fx, double fy, double factor) {
+	// The centre moves toward the anchor by (1 - factor) of its distance
+	int bits = precision_bits();
+	center_x += BigFixed((fx - 0.5) * (1.0 - factor) * span_x, log_scale, bits);
+	center_y += BigFixed((fy - 0.5) * (1.0 - factor) * span_y, log_scale, bits);
+	span_x *= factor;
+	span_y *= factor;
+	zoom *= factor;
+	normalize();
+}
+
+void Viewport::pan(double fx, double fy) {
+	int bits = precision_bits();
+	center_x += BigFixed(fx * span_x, log_scale, bits);
+	center_y += BigFixed(fy * span_y, log_scale, bits);
+	normalize();
+}
+
+// Moves powers of two between the spans and log_scale, and resizes the
+// centre to the precision the new scale needs.
+void Viewport::normalize() {
+	double larger = std::max(std::fabs(span_x), std::fabs(span_y));
+	if (larger > 0.0 && std::isfinite(larger)) {
+		int exponent;
+		std::frexp(larger, &exponent);
+		span_x = std::ldexp(span_x, 1 - exponent);
+		span_y = std::ldexp(span_y, 1 - exponent);
+		log_scale += exponent - 1;
+	}
+	center_x.set_fraction_bits(precision_bits());
+	center_y.set_fraction_bits(precision_bits());
+}
@@ -0,0 +1,89 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <cmath>
+
+#include "big_fixed.h"
+#include "double_double.h"
+
+#define VIEWPORT_GUARD_BITS 96 // centre bits kept below the extent of the view
+
+typedef DoubleDouble<double> Coordinate;
+
+// Edges of a view in the arithmetic of Real, for the code that works on
+// bounds: the shader and line fractals (double) and the float, double and
+// double-double kernels.
+template <typename Real>
+struct BasicViewport {
+	Real x_min = -2.0, x_max = 1.0;
+	Real y_min = -1.5, y_max = 1.5;
+	double zoom = 1.0;
+};
+
+typedef BasicViewport<double> DoubleViewport;
+typedef BasicViewport<Coordinate> CoordinateViewport;
+
+// Position of pixel index of count pixels spanning [min, max], in the
+// arithmetic of Real.
+template <typename Real>
+inline Real pixel_coordinate(const Real& min, const Real& max, int index, int count) {
+	return min + (max - min) * index / count;
+}
+
+// A view as an arbitrary-precision centre and extents of span * 2^log_scale.
+// The edges of a deep view agree in all their leading digits, so storing
+// them loses the extent to cancellation; here zooming and panning move the
+// centre by an amount worked out at the scale of the view, and the centre
+// keeps VIEWPORT_GUARD_BITS below the extent however deep it goes.
+struct Viewport {
+	BigFixed center_x, center_y;
+	int log_scale = 0;                 // extents are span_x * 2^log_scale by span_y * 2^log_scale
+	double span_x = 1.5, span_y = 1.5; // the larger one is kept in [1, 2)
+	double zoom = 1.0;
+
+	Viewport() : Viewport(-2.0, 1.0, -1.5, 1.5) {}
+	Viewport(double x_min, double x_max, double y_min, double y_max, double zoom = 1.0);
+
+	double width() const { return std::ldexp(span_x, log_scale); }
+	double height() const { return std::ldexp(span_y, log_scale); }
+
+	// Scales the extents by factor (below 1 zooms in) keeping the point at
+	// (fx, fy) in place, given as fractions of the extents from the
+	// (x_min, y_min) corner.
+	void zoom_at(double fx, double fy, double factor);
+
+	// Moves the view by (fx, fy) times its extents.
+	void pan(double fx, double fy);
+
+	// Offset of pixel index of count from the centre, in units of
+	// 2^log_scale, so it stays in range at any depth.
+	double pixel_offset_x(int index, int count) const { return (static_cast<double>(index) / count - 0.5) * span_x; }
+	double pixel_offset_y(int index, int count) const { return (static_cast<double>(index) / count - 0.5) * span_y; }
+
+	// Bits the centre is kept to at this scale
+	int precision_bits() const { return log_scale < VIEWPORT_GUARD_BITS - 64 ? VIEWPORT_GUARD_BITS - log_scale : 64; }
+
+	template <typename Real>
+	BasicViewport<Real> bounds() const {
+		BasicViewport<Real> view;
+		Real x = static_cast<Real>(center_x), y = static_cast<Real>(center_y);
+		double half_x = 0.5 * width(), half_y = 0.5 * height();
+		view.x_min = x - half_x;
+		view.x_max = x + half_x;
+		view.y_min = y - half_y;
+		view.y_max = y + half_y;
+		view.zoom = zoom;
+		return view;
+	}
+
+private:
+	void normalize();
+};
+
+inline bool operator==(const Viewport& a, const Viewport& b) {
+	return a.center_x == b.center_x && a.center_y == b.center_y && a.log_scale == b.log_scale &&
+		a.span_x == b.span_x && a.span_y == b.span_y && a.zoom == b.zoom;
+}
+inline bool operator!=(const Viewport& a, const Viewport& b) { return !(a == b); }
+
+#endif